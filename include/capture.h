@@ -0,0 +1,44 @@
+// include/capture.h
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Output capture for a background job: a pipe the job writes its stdout and
+ * stderr into, drained by the shell into a fixed-size ring buffer backed by
+ * a memfd. When the ring is full the oldest bytes are overwritten, so the
+ * job never waits on the terminal and its memory cost is capped.
+ */
+typedef struct capture capture_t;
+
+/* Create a capture with a ring of size bytes. Returns NULL on error
+ * (errno is ENOSYS where memfds are unavailable).
+ */
+capture_t *capture_open(size_t size);
+
+/* Write end of the pipe, for the job's children to dup2() */
+int capture_child_fd(const capture_t *c);
+
+/* Close the parent's copy of the write end once the job is spawned */
+void capture_spawned(capture_t *c);
+
+/* Read end to poll for input, or -1 once the job's output is at EOF */
+int capture_poll_fd(const capture_t *c);
+
+/* Move whatever the pipe holds into the ring without blocking.
+ * Returns the number of bytes read.
+ */
+size_t capture_drain(capture_t *c);
+
+/* Write the ring's bytes from stream offset *pos onwards to fd and advance
+ * *pos to the end. Bytes already overwritten are skipped.
+ */
+void capture_dump(const capture_t *c, uint64_t *pos, int fd);
+
+/* Stream offset of the oldest byte still in the ring */
+uint64_t capture_oldest(const capture_t *c);
+
+void capture_free(capture_t *c);
+
+#endif /* CAPTURE_H */
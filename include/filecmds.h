@@ -0,0 +1,19 @@
+// include/filecmds.h
+#ifndef FILECMDS_H
+#define FILECMDS_H
+
+/* Builtin cat and cp. They copy through copy_file_range/sendfile/splice
+ * where the file types allow it, so data stays in the kernel.
+ */
+
+/* Returns 1 if argv is a cat/cp invocation the builtins can handle
+ * (no options), 0 if the external program should be run instead.
+ */
+int filecmd_supported(char **argv);
+
+/* Run a supported cat/cp with the given stdin/stdout descriptors.
+ * Returns the exit status.
+ */
+int filecmd_run(char **argv, int in_fd, int out_fd);
+
+#endif /* FILECMDS_H */
@@ -0,0 +1,40 @@
+// include/history.h
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Persistent command history. Lines are appended to a log file
+ * ($OSH_HISTFILE, default ~/.osh_history) with a fixed-size record per
+ * entry in a sidecar index (<log>.idx). Both are mmapped, so startup cost
+ * and memory do not grow with the history; entry N is one index lookup.
+ * A hashed prefix and trigram index (<log>.gram, <log>.post) serves
+ * !prefix and history -g.
+ */
+
+/* Open and map the history files. History is only kept for interactive
+ * shells unless OSH_HISTFILE is set. Returns 0, or -1 if disabled.
+ */
+int history_init(void);
+void history_shutdown(void);
+
+/* Append line (no trailing newline) unless it is blank or repeats the
+ * previous entry.
+ */
+void history_add(const char *line);
+
+/* Expand a leading event designator: !! (previous), !N, !-N or !prefix
+ * (most recent entry starting with prefix); the rest of the line is kept.
+ * Returns 1 with *out set to a malloc'd line, 0 if line has no designator,
+ * or -1 if the event is not found (already reported).
+ */
+int history_expand(const char *line, char **out);
+
+/* history [N]: print the last n entries (0: all) with their numbers */
+void history_print(FILE *f, size_t n);
+
+/* history -g STR: print every entry containing str */
+void history_grep(FILE *f, const char *str);
+
+#endif /* HISTORY_H */
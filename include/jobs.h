@@ -2,7 +2,10 @@
 #ifndef JOBS_H
 #define JOBS_H
 
+#include <signal.h>
 #include <sys/types.h>
+#include "limit.h"
+#include "capture.h"
 
 typedef enum
 {
@@ -14,11 +17,75 @@ typedef enum
 void jobs_init(void);
 void jobs_shutdown(void);
 
-int add_job(pid_t pgid, const char *cmdline, job_state_t state);
+/* Register a job; pids are its member processes in pipeline order */
+int add_job(pid_t pgid, const pid_t *pids, int npids, const char *cmdline,
+            job_state_t state, const job_limits_t *limits);
 void reap_jobs(void);
+void update_job_proc(pid_t pid, int status);
 
-void list_jobs(void);
+/* waitpid(pid, status, WUNTRACED) for a foreground child that keeps the
+ * timeout wheel running while it waits. Call with SIGCHLD blocked.
+ */
+pid_t wait_child(pid_t pid, int *status);
+
+/* Wait in the foreground for job pgid to finish or stop. Call with SIGCHLD
+ * blocked. Removes the job when it finishes. Returns the exit status of its
+ * last command (see status_to_code; timeout_expired() if its timeout fired),
+ * or -1 if there is no such job.
+ */
+int wait_job(pid_t pgid);
+
+/* Convert a waitpid() status to a shell exit status ($?) */
+int status_to_code(int wstatus);
+
+/* list_jobs() flags */
+#define JOBS_LONG 1 /* jobs -l: also print resource limits */
+#define JOBS_IO 2   /* jobs -v: per-process I/O rates, CPU% and blocking */
+
+void list_jobs(int flags);
+
+/* Number of jobs in the Running state */
+int jobs_running(void);
 pid_t get_job_pgid(int jobnum);
+
+/* Output capture (the `capture` builtin): ring size for new background
+ * jobs, or 0 to let them write to the terminal.
+ */
+void jobs_set_capture(size_t bytes);
+size_t jobs_capture_size(void);
+
+/* Hand job pgid the capture its output goes to; the job owns it after */
+void job_attach_capture(pid_t pgid, capture_t *c);
+
+/* Hand job pgid its members' exec error pipes (one per member, -1 for
+ * none); each is collected when its member is reaped. The job owns them.
+ */
+void job_attach_exec_errors(pid_t pgid, const int *fds);
+
+/* Read the exec error pipe of an exited stage, counting a reported exec
+ * failure in ST_EXEC_FAIL, and close it. fd may be -1.
+ */
+void collect_exec_error(int fd);
+
+/* jobs -o %N: print job jobnum's captured output. With follow, keep
+ * printing as it arrives until the job closes its output or *stop is set.
+ * Returns 0, or -1 if the job has no captured output.
+ */
+int job_output(int jobnum, int follow, volatile sig_atomic_t *stop);
+
+/* 1 if the shell must poll rather than block: timeouts are armed or
+ * captured output may arrive.
+ */
+int jobs_need_poll(void);
+
+/* Sleep until fd (ignored if < 0) is readable or timeout_ms passes (-1:
+ * no limit), firing due timeouts and draining captured output meanwhile.
+ * Returns 1 when fd is readable, 0 on any other wakeup, -1 on error.
+ */
+int jobs_poll(int fd, int timeout_ms);
+
+/* Sleep for secs the same way; returns early once *stop is set (may be NULL) */
+void jobs_sleep(double secs, volatile sig_atomic_t *stop);
 void set_job_state(pid_t pgid, job_state_t st);
 void remove_job(pid_t pgid);
 
@@ -0,0 +1,48 @@
+// include/limit.h
+#ifndef LIMIT_H
+#define LIMIT_H
+
+#include <stddef.h>
+#include <sys/resource.h>
+
+#define LIMIT_MAX_CPUS 1024
+#define LIMIT_MASK_WORDS (LIMIT_MAX_CPUS / (8 * sizeof(unsigned long)))
+
+/* which fields of job_limits_t are set */
+#define LIMIT_CPUS (1 << 0)
+#define LIMIT_NICE (1 << 1)
+#define LIMIT_MEM (1 << 2)
+#define LIMIT_NOFILE (1 << 3)
+
+/* Resource settings given by the `limit` prefix. Plain data so it can be
+ * copied by value into a job entry.
+ */
+typedef struct job_limits
+{
+    int set;                                 /* LIMIT_* flags */
+    unsigned long cpumask[LIMIT_MASK_WORDS]; /* allowed cpus */
+    char cpulist[64];                        /* --cpus argument as given */
+    int nice;                                /* --nice value */
+    rlim_t mem;                              /* --mem in bytes (RLIMIT_AS) */
+    rlim_t nofile;                           /* --nofile (RLIMIT_NOFILE) */
+} job_limits_t;
+
+/* Parse leading `--opt value` pairs from argv (argv[0] is "limit").
+ * Returns the index of the first word of the command, or -1 on error.
+ */
+int parse_limits(char **argv, job_limits_t *lim);
+
+/* Apply limits to the calling process. Called in the child between fork()
+ * and execv(). Returns 0 on success, -1 on error (already reported).
+ */
+int apply_limits(const job_limits_t *lim);
+
+/* Parse a size with optional K/M/G/T suffix (powers of 1024).
+ * Returns 0, or -1 if s is malformed or does not fit below RLIM_INFINITY.
+ */
+int parse_size(const char *s, rlim_t *out);
+
+/* Render the set limits as "cpus=0-7 nice=10 ..." into buf. */
+void format_limits(const job_limits_t *lim, char *buf, size_t len);
+
+#endif /* LIMIT_H */
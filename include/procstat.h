@@ -0,0 +1,31 @@
+// include/procstat.h
+#ifndef PROCSTAT_H
+#define PROCSTAT_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* One sample of a process's counters from /proc */
+typedef struct proc_sample
+{
+    uint64_t t_ns;            /* when the sample was taken */
+    unsigned long long rchar; /* bytes read (any fd, incl. pipes) */
+    unsigned long long wchar; /* bytes written */
+    unsigned long long ticks; /* utime + stime in clock ticks */
+    char state;               /* R, S, D, T, Z ... */
+    char comm[17];            /* command name */
+    char wchan[32];           /* kernel wait channel, "" if unknown */
+} proc_sample_t;
+
+/* Read /proc/<pid>/{stat,io,wchan}. Returns 0 on success, -1 if the
+ * process is gone or /proc is unavailable.
+ */
+int proc_sample(pid_t pid, proc_sample_t *out);
+
+/* Print one line for a member process: rates between prev and cur.
+ * prev may be NULL (rates shown as "-").
+ */
+void proc_print_rates(int stage, pid_t pid, const proc_sample_t *prev,
+                      const proc_sample_t *cur);
+
+#endif /* PROCSTAT_H */
@@ -0,0 +1,22 @@
+// include/replicate.h
+#ifndef REPLICATE_H
+#define REPLICATE_H
+
+#include "shell.h"
+
+/* Run stage c as c->replicas parallel workers (syntax: `a |[N] c | b`).
+ * Called in the stage's child with stdin/stdout already connected to the
+ * neighbouring stages. Input is cut into chunks of whole records (lines,
+ * or NUL-terminated with REP_NUL). Without REP_ORDERED, N long-lived
+ * workers take chunks as they go idle and whole output records are merged
+ * as they arrive. With REP_ORDERED each chunk runs in a fresh worker (N at
+ * a time) and chunk outputs are emitted in input order; its chunks are
+ * larger by default, so each worker start covers more input. c->rep_chunk
+ * overrides the chunk size. exec_worker execs
+ * one copy of c in a worker child. Exits with the first non-zero worker
+ * status; never returns.
+ */
+void run_replicated(command_t *c, const char *path,
+                    void (*exec_worker)(command_t *, const char *));
+
+#endif /* REPLICATE_H */
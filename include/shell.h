@@ -3,6 +3,27 @@
 #define SHELL_H
 
 #include <sys/types.h>
+#include "limit.h"
+#include "timer.h"
+
+struct command;
+
+/* procsub_t.argi values for substitutions used as redirection targets */
+#define PROCSUB_INFILE (-1)
+#define PROCSUB_OUTFILE (-2)
+
+/* A process substitution <(pipeline) or >(pipeline) in a command */
+typedef struct procsub
+{
+    int argi;             /* argv index it replaces, or PROCSUB_INFILE/OUTFILE */
+    int dir;              /* '<': command reads its output, '>': writes its input */
+    struct command *cmd;  /* the nested pipeline */
+    struct procsub *next; /* next substitution of the same command */
+} procsub_t;
+
+/* command_t.rep_flags, from `|[N,ordered,nul,chunk=SIZE]` */
+#define REP_ORDERED 1 /* emit each chunk's output in input order */
+#define REP_NUL 2     /* records end in NUL instead of newline */
 
 /* A single command in a pipeline */
 typedef struct command
@@ -11,9 +32,43 @@ typedef struct command
     char *infile;         /* input redirection file or NULL */
     char *outfile;        /* output redirection file or NULL */
     int append;           /* 1 if >> was used */
+    procsub_t *subs;      /* process substitutions (NULL if none) */
+    int replicas;         /* parallel copies from `|[N]` (0 or 1: just one) */
+    int rep_flags;        /* REP_* */
+    size_t rep_chunk;     /* input bytes per chunk from chunk=SIZE (0: default) */
     struct command *next; /* next command in pipeline (NULL if last) */
 } command_t;
 
+/* Connector joining a pipeline to the previous one in a command list */
+typedef enum
+{
+    LIST_SEQ, /* first entry, or after ';' or '&' */
+    LIST_AND, /* after '&&': run only if previous status == 0 */
+    LIST_OR   /* after '||': run only if previous status != 0 */
+} list_op_t;
+
+/* One pipeline of a command list. The text is parsed only when the entry
+ * is about to run, so $? sees the status of the entry before it.
+ */
+typedef struct cmdlist
+{
+    char *text;           /* source text of the pipeline */
+    list_op_t op;         /* how this entry joins the previous one */
+    int background;       /* 1 if terminated by '&' */
+    struct cmdlist *next; /* next entry (NULL if last) */
+} cmdlist_t;
+
+/* Exit status of the last pipeline run in the foreground; expanded for $? */
+extern int last_status;
+
+/* Split a line on ';', '&', '&&' and '||' (outside quotes).
+ * Returns NULL on syntax error or empty line.
+ */
+cmdlist_t *split_list(const char *line);
+
+/* Free split_list result */
+void free_cmdlist(cmdlist_t *l);
+
 /* Parser: parse a line into a linked list of command_t (pipeline).
  * Caller must free the returned command chain via free_command_chain()
  * Returns NULL on parse error or empty line.
@@ -23,10 +78,19 @@ command_t *parse_line(const char *line);
 /* Free parser result */
 void free_command_chain(command_t *cmd);
 
+/* Look cmd up in PATH (used as is if it contains a '/'). Returns a
+ * malloc'd path, or NULL if not found.
+ */
+char *which_in_path(const char *cmd);
+
 /* Executor: execute a pipeline (cmd points to head). If background==1,
  * do not wait for pipeline to finish and register job.
- * Returns 0 on success, -1 on error.
+ * limits (may be NULL) is applied to every process of the pipeline;
+ * tmo (may be NULL) arms a timeout on its process group.
+ * Returns the exit status of the last command (0 when backgrounded,
+ * 128+N if it was killed or stopped by signal N), or -1 on error.
  */
-int execute_pipeline(command_t *cmd, int background, const char *rawline);
+int execute_pipeline(command_t *cmd, int background, const char *rawline,
+                     const job_limits_t *limits, const job_timeout_t *tmo);
 
 #endif /* SHELL_H */
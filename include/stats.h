@@ -0,0 +1,46 @@
+// include/stats.h
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Cumulative counters kept by the shell's hot paths */
+typedef enum
+{
+    ST_LINES,     /* pipelines parsed by parse_line() */
+    ST_FORKS,     /* successful fork() calls */
+    ST_EXEC_FAIL, /* commands that could not be executed */
+    ST_PATH_HIT,  /* PATH searches that found the command */
+    ST_PATH_MISS, /* PATH searches that did not */
+    ST_SIGCHLD,   /* SIGCHLD deliveries */
+    ST_REAPS,     /* children reaped by reap_jobs() */
+    ST_COUNT
+} stats_counter_t;
+
+/* Latency histograms (log2 microsecond buckets) */
+typedef enum
+{
+    HIST_PARSE,   /* parse_line() time */
+    HIST_FG_WAIT, /* time spent waiting for foreground jobs */
+    HIST_COUNT
+} stats_hist_t;
+
+/* volatile: some counters are bumped from the SIGCHLD handler */
+extern volatile unsigned long stats_counters[ST_COUNT];
+
+#define STATS_INC(c) (stats_counters[(c)]++)
+
+/* Monotonic clock in nanoseconds */
+uint64_t stats_now_ns(void);
+
+/* Add one sample of ns nanoseconds to histogram h */
+void stats_record(stats_hist_t h, uint64_t ns);
+
+/* Print all counters and histograms, human-readable or as one JSON object */
+void stats_print(FILE *f, int json);
+
+/* If $OSH_STATS_FILE is set, write the JSON stats there ("-" = stderr) */
+void stats_dump_at_exit(void);
+
+#endif /* STATS_H */
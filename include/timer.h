@@ -0,0 +1,55 @@
+// include/timer.h
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Settings given by the `timeout` prefix */
+typedef struct job_timeout
+{
+    uint64_t ms;            /* run time allowed */
+    int sig;                /* signal sent to the process group on expiry */
+    uint64_t kill_after_ms; /* then SIGKILL after this grace (0 = never) */
+} job_timeout_t;
+
+/* Exit status of a job that hit its timeout (as timeout(1)); a job that
+ * had to be sent SIGKILL exits 128+SIGKILL instead
+ */
+#define TIMEOUT_STATUS 124
+
+/* Create the shared timerfd. Returns 0, or -1 if unsupported. */
+int timer_init(void);
+
+/* The timerfd to poll for readability, or -1 */
+int timer_fd(void);
+
+/* Number of timeouts currently armed on the wheel */
+int timer_pending(void);
+
+/* Fire every due timeout. Call when timer_fd() is readable. */
+void timer_service(void);
+
+/* Arm a timeout for process group pgid */
+int timeout_arm(pid_t pgid, const job_timeout_t *t);
+
+/* The job finished: stop its timer but remember whether it fired.
+ * Safe to call from the SIGCHLD handler.
+ */
+void timeout_disarm(pid_t pgid);
+
+/* Drop all state for pgid */
+void timeout_forget(pid_t pgid);
+
+/* 0 if pgid's timeout has not fired, else the job's exit status:
+ * TIMEOUT_STATUS, or 128+SIGKILL once the group was sent SIGKILL
+ */
+int timeout_expired(pid_t pgid);
+
+/* Parse leading options of `timeout [-s SIG] [-k grace] duration cmd...`
+ * (argv[0] is "timeout"). A duration of 0 means no timeout. Returns the
+ * index of the first command word, or -1 on error.
+ */
+int parse_timeout(char **argv, job_timeout_t *t);
+
+#endif /* TIMER_H */
@@ -0,0 +1,24 @@
+// include/xargs.h
+#ifndef XARGS_H
+#define XARGS_H
+
+#include <sys/types.h>
+
+/* Builtin `xargs [-P N] [-n M] [-0] cmd ...`, run as a pipeline stage. The
+ * stage packs the items on its stdin into argv batches as large as
+ * ARG_MAX allows and forks them itself, so no xargs binary is exec'd and
+ * every batch stays in the job's process group.
+ */
+
+/* Returns 1 if argv is an xargs invocation */
+int xargs_supported(char **argv);
+
+/* Run xargs with stdin as the item source. spawn starts one batch (argv,
+ * the resolved path of argv[0] or NULL for a builtin) and returns its pid,
+ * or -1. Returns the exit status, as GNU xargs: 123 if a batch failed,
+ * 124 if one exited 255, 125 if one was killed, 126/127 if cmd could not
+ * be run.
+ */
+int xargs_run(char **argv, pid_t (*spawn)(char **argv, const char *path));
+
+#endif /* XARGS_H */
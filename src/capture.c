@@ -0,0 +1,143 @@
+// src/capture.c
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "capture.h"
+
+#define DRAIN_MAX (1024 * 1024) /* bytes moved per drain call, so one job cannot starve the rest */
+
+struct capture
+{
+    int rd;         /* pipe read end (-1 at EOF) */
+    int wr;         /* pipe write end (-1 once the job is spawned) */
+    char *ring;
+    size_t size;
+    uint64_t total; /* bytes ever captured; ring holds the last size of them */
+};
+
+capture_t *capture_open(size_t size)
+{
+#ifdef __linux__
+    capture_t *c = calloc(1, sizeof(capture_t));
+    if (!c)
+        return NULL;
+    c->rd = c->wr = -1;
+    c->size = size;
+
+    /* the mapping keeps the memfd's pages alive; no need to hold the fd */
+    int p[2];
+    int memfd = memfd_create("osh-capture", MFD_CLOEXEC);
+    if (memfd < 0)
+        goto fail;
+    if (ftruncate(memfd, (off_t)size) == 0)
+        c->ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    close(memfd);
+    if (!c->ring || c->ring == MAP_FAILED)
+    {
+        c->ring = NULL;
+        goto fail;
+    }
+    if (pipe2(p, O_CLOEXEC) < 0)
+        goto fail;
+    c->rd = p[0];
+    c->wr = p[1];
+    fcntl(c->rd, F_SETFL, O_NONBLOCK);
+    return c;
+
+fail:
+    capture_free(c);
+    return NULL;
+#else
+    (void)size;
+    errno = ENOSYS;
+    return NULL;
+#endif
+}
+
+int capture_child_fd(const capture_t *c)
+{
+    return c->wr;
+}
+
+void capture_spawned(capture_t *c)
+{
+    if (c->wr >= 0)
+        close(c->wr);
+    c->wr = -1;
+}
+
+int capture_poll_fd(const capture_t *c)
+{
+    return c->rd;
+}
+
+size_t capture_drain(capture_t *c)
+{
+    size_t got = 0;
+    while (c->rd >= 0 && got < DRAIN_MAX)
+    {
+        /* read straight into the ring, up to its physical end */
+        size_t at = c->total % c->size;
+        ssize_t r = read(c->rd, c->ring + at, c->size - at);
+        if (r > 0)
+        {
+            c->total += (uint64_t)r;
+            got += (size_t)r;
+        }
+        else if (r < 0 && errno == EINTR)
+            continue;
+        else if (r < 0 && errno == EAGAIN)
+            break;
+        else
+        {
+            close(c->rd);
+            c->rd = -1;
+        }
+    }
+    return got;
+}
+
+void capture_dump(const capture_t *c, uint64_t *pos, int fd)
+{
+    if (*pos < capture_oldest(c))
+        *pos = capture_oldest(c);
+
+    while (*pos < c->total)
+    {
+        size_t at = *pos % c->size;
+        size_t n = c->size - at;
+        if (n > c->total - *pos)
+            n = (size_t)(c->total - *pos);
+        ssize_t w = write(fd, c->ring + at, n);
+        if (w < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            *pos = c->total; /* reader gone: skip the rest */
+            break;
+        }
+        *pos += (uint64_t)w;
+    }
+}
+
+uint64_t capture_oldest(const capture_t *c)
+{
+    return c->total > c->size ? c->total - c->size : 0;
+}
+
+void capture_free(capture_t *c)
+{
+    if (!c)
+        return;
+    if (c->ring)
+        munmap(c->ring, c->size);
+    if (c->rd >= 0)
+        close(c->rd);
+    if (c->wr >= 0)
+        close(c->wr);
+    free(c);
+}
@@ -4,15 +4,20 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
 #include "shell.h"
 #include "jobs.h"
+#include "filecmds.h"
+#include "stats.h"
+#include "replicate.h"
+#include "xargs.h"
 
 /* Helper: find executable in PATH (simple) */
-static char *which_in_path(const char *cmd)
+char *which_in_path(const char *cmd)
 {
     if (!cmd)
         return NULL;
@@ -20,7 +25,10 @@ static char *which_in_path(const char *cmd)
         return strdup(cmd); /* contains slash -> direct path */
     char *path = getenv("PATH");
     if (!path)
+    {
+        STATS_INC(ST_PATH_MISS);
         return NULL;
+    }
     char *pfx = strdup(path);
     char *saveptr = NULL;
     char *dir = strtok_r(pfx, ":", &saveptr);
@@ -37,39 +45,42 @@ static char *which_in_path(const char *cmd)
         if (access(candidate, X_OK) == 0)
         {
             free(pfx);
+            STATS_INC(ST_PATH_HIT);
             return candidate;
         }
         free(candidate);
         dir = strtok_r(NULL, ":", &saveptr);
     }
     free(pfx);
+    STATS_INC(ST_PATH_MISS);
     return NULL;
 }
 
-/* Execute a single command (no pipes) inside child process.
- * Exits the process on error.
+static void free_paths(char **paths, int n)
+{
+    for (int i = 0; i < n; i++)
+        free(paths[i]);
+    free(paths);
+}
+
+/* Open c's redirection files. *in / *out are set to the opened
+ * descriptors, or -1 when there is no redirection.
+ * Returns 0 on success, -1 on error (already reported).
  */
-static void exec_single(command_t *c)
+static int open_redirs(command_t *c, int *in, int *out)
 {
-    if (!c || !c->argv || !c->argv[0])
-        _exit(127);
+    *in = -1;
+    *out = -1;
 
     /* handle input redirection */
     if (c->infile)
     {
-        int fd = open(c->infile, O_RDONLY);
-        if (fd < 0)
+        *in = open(c->infile, O_RDONLY);
+        if (*in < 0)
         {
             perror("open infile");
-            _exit(127);
-        }
-        if (dup2(fd, STDIN_FILENO) < 0)
-        {
-            perror("dup2 infile");
-            close(fd);
-            _exit(127);
+            return -1;
         }
-        close(fd);
     }
 
     /* handle output redirection */
@@ -80,53 +91,331 @@ static void exec_single(command_t *c)
             flags |= O_APPEND;
         else
             flags |= O_TRUNC;
-        int fd = open(c->outfile, flags, 0644);
-        if (fd < 0)
+        *out = open(c->outfile, flags, 0644);
+        if (*out < 0)
         {
             perror("open outfile");
+            if (*in >= 0)
+                close(*in);
+            *in = -1;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* In a child: point stdin/stdout at c's redirections, exiting on failure */
+static void apply_redirs(command_t *c)
+{
+    int in, out;
+    if (open_redirs(c, &in, &out) < 0)
+        _exit(127);
+    if (in >= 0)
+    {
+        if (dup2(in, STDIN_FILENO) < 0)
+        {
+            perror("dup2 infile");
             _exit(127);
         }
-        if (dup2(fd, STDOUT_FILENO) < 0)
+        close(in);
+    }
+    if (out >= 0)
+    {
+        if (dup2(out, STDOUT_FILENO) < 0)
         {
             perror("dup2 outfile");
-            close(fd);
             _exit(127);
         }
-        close(fd);
+        close(out);
+    }
+}
+
+static pid_t spawn_batch(char **argv, const char *path);
+
+/* In a stage's child: write end of a close-on-exec pipe to the shell.
+ * Only a failed exec writes to it; a successful one just closes it.
+ */
+static int exec_err_fd = -1;
+
+/* Stop reporting: this process will not exec the stage's command */
+static void exec_report_done(void)
+{
+    if (exec_err_fd >= 0)
+        close(exec_err_fd);
+    exec_err_fd = -1;
+}
+
+static void exec_report_failure(int err)
+{
+    if (exec_err_fd >= 0 && write(exec_err_fd, &err, sizeof(err)) < 0)
+        perror("write");
+    exec_report_done();
+}
+
+/* Execute a single command (no pipes) inside child process.
+ * path is c's executable as resolved by the parent (NULL if not found).
+ * Exits the process on error.
+ */
+static void exec_single(command_t *c, const char *path)
+{
+    if (!c || !c->argv || !c->argv[0])
+        _exit(127);
+
+    apply_redirs(c);
+
+    /* builtin cat/cp: no execv() needed */
+    if (filecmd_supported(c->argv))
+    {
+        exec_report_done();
+        _exit(filecmd_run(c->argv, STDIN_FILENO, STDOUT_FILENO));
+    }
+
+    /* builtin xargs: this stage forks the batches itself */
+    if (xargs_supported(c->argv))
+    {
+        exec_report_done();
+        _exit(xargs_run(c->argv, spawn_batch));
     }
 
-    char *path = which_in_path(c->argv[0]);
     if (!path)
     {
         fprintf(stderr, "osh: command not found: %s\n", c->argv[0]);
+        exec_report_failure(ENOENT);
         _exit(127);
     }
     execv(path, c->argv);
+    int err = errno;
     perror("execv");
-    free(path);
-    _exit(127);
+    exec_report_failure(err);
+    _exit(err == ENOENT ? 127 : 126);
 }
 
-/* Execute a pipeline (possibly single command). If background == 1, do not wait.
- * rawline is used for job listing.
+/* Run a lone foreground cat/cp in the shell process itself, with its
+ * redirections opened here instead of dup2()'d over the shell's stdio.
  */
-int execute_pipeline(command_t *cmd, int background, const char *rawline)
+static int run_filecmd_inline(command_t *c)
 {
-    if (!cmd)
-        return -1;
+    int in, out;
+    if (open_redirs(c, &in, &out) < 0)
+        return 1;
 
-    /* count commands */
+    /* a closed reader must not kill the shell */
+    struct sigaction ign, old;
+    ign.sa_handler = SIG_IGN;
+    sigemptyset(&ign.sa_mask);
+    ign.sa_flags = 0;
+    sigaction(SIGPIPE, &ign, &old);
+
+    fflush(stdout);
+    int rc = filecmd_run(c->argv,
+                         in >= 0 ? in : STDIN_FILENO,
+                         out >= 0 ? out : STDOUT_FILENO);
+
+    sigaction(SIGPIPE, &old, NULL);
+    if (in >= 0)
+        close(in);
+    if (out >= 0)
+        close(out);
+    return rc;
+}
+
+/* 1 if path names a regular file (or, with absent_ok, nothing yet, or a
+ * directory with dir_ok)
+ */
+static int is_regular(const char *path, int absent_ok, int dir_ok)
+{
+    struct stat st;
+    if (stat(path, &st) < 0)
+        return absent_ok && errno == ENOENT;
+    return S_ISREG(st.st_mode) || (dir_ok && S_ISDIR(st.st_mode));
+}
+
+/* True if c is a lone cat/cp that can run without forking. The shell
+ * ignores SIGINT, so only copies between regular files are inlined: a
+ * device, fifo or terminal could block forever, and in a child Ctrl-C and
+ * job control still work.
+ */
+static int can_inline(command_t *c)
+{
+    if (c->next || c->subs || !filecmd_supported(c->argv))
+        return 0;
+    if (c->outfile && !is_regular(c->outfile, 1, 0))
+        return 0;
+
+    int argc = 0;
+    while (c->argv[argc])
+        argc++;
+
+    if (strcmp(c->argv[0], "cp") == 0)
+    {
+        /* sources, then a destination file or directory */
+        if (argc < 3 || !is_regular(c->argv[argc - 1], 1, 1))
+            return 0;
+        for (int i = 1; i < argc - 1; i++)
+            if (!is_regular(c->argv[i], 0, 0))
+                return 0;
+        return 1;
+    }
+
+    /* cat writes to the shell's own stdout unless redirected */
+    struct stat st;
+    if (!c->outfile && (fstat(STDOUT_FILENO, &st) < 0 || !S_ISREG(st.st_mode)))
+        return 0;
+
+    /* cat reads stdin when it has no file arguments or is given "-" */
+    int reads_stdin = (argc == 1);
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(c->argv[i], "-") == 0)
+            reads_stdin = 1;
+        else if (!is_regular(c->argv[i], 0, 0))
+            return 0;
+    }
+    if (reads_stdin)
+        return c->infile && is_regular(c->infile, 0, 0);
+    return !c->infile || is_regular(c->infile, 0, 0);
+}
+
+static void spawn_stages(command_t *cmd, int n, pid_t pgid, pid_t *pids,
+                         char **paths, const job_limits_t *limits,
+                         const sigset_t *childmask, int outfd, int *errfds);
+static void exec_stage(command_t *c, const char *path);
+
+/* Start one xargs batch in our process group, with stdin from /dev/null
+ * so the command cannot eat the remaining items.
+ */
+static pid_t spawn_batch(char **argv, const char *path)
+{
+    command_t c;
+    memset(&c, 0, sizeof(c));
+    c.argv = argv;
+    c.infile = "/dev/null";
+
+    char *paths[1] = {(char *)path};
+    pid_t pid = 0;
+    sigset_t mask;
+    sigprocmask(SIG_SETMASK, NULL, &mask);
+    spawn_stages(&c, 1, getpgrp(), &pid, paths, NULL, &mask, -1, NULL);
+    return pid > 0 ? pid : -1;
+}
+
+/* Body of a process substitution: run pipeline sub with stdin/stdout
+ * already connected to the outer command, then exit. Never returns.
+ */
+static void run_procsub(command_t *sub)
+{
     int n = 0;
-    for (command_t *c = cmd; c; c = c->next)
+    for (command_t *c = sub; c; c = c->next)
         n++;
 
+    if (n == 1)
+        exec_stage(sub, NULL);
+
+    /* a pipeline: fork its stages into our process group and wait */
+    signal(SIGCHLD, SIG_DFL);
     pid_t *pids = calloc(n, sizeof(pid_t));
     if (!pids)
+        _exit(127);
+    sigset_t mask;
+    sigprocmask(SIG_SETMASK, NULL, &mask);
+    spawn_stages(sub, n, getpgrp(), pids, NULL, NULL, &mask, -1, NULL);
+
+    int status = 0;
+    for (int i = 0; i < n; i++)
+        if (pids[i] > 0)
+            waitpid(pids[i], &status, 0);
+    _exit(status_to_code(status));
+}
+
+/* Start c's process substitutions, concurrently and in our process group,
+ * and replace their words with /dev/fd/N paths to the connecting pipes.
+ * Runs in the stage's child just before exec.
+ */
+static void start_procsubs(command_t *c)
+{
+    int nsubs = 0;
+    for (procsub_t *ps = c->subs; ps; ps = ps->next)
+        nsubs++;
+    /* our ends of earlier pipes; later helpers close them */
+    int *kept = malloc(nsubs * sizeof(int));
+    int nkept = 0;
+    if (!kept)
     {
-        perror("calloc");
-        return -1;
+        perror("malloc");
+        _exit(127);
+    }
+
+    for (procsub_t *ps = c->subs; ps; ps = ps->next)
+    {
+        int fds[2];
+        if (pipe(fds) < 0)
+        {
+            perror("pipe");
+            _exit(127);
+        }
+        /* '<': we read what the pipeline writes; '>': the reverse */
+        int ours = (ps->dir == '<') ? fds[0] : fds[1];
+        int theirs = (ps->dir == '<') ? fds[1] : fds[0];
+
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("fork");
+            _exit(127);
+        }
+        if (pid == 0)
+        {
+            /* only the stage's own exec is reported, not the helpers' */
+            exec_report_done();
+            dup2(theirs, ps->dir == '<' ? STDOUT_FILENO : STDIN_FILENO);
+            close(theirs);
+            close(ours);
+            for (int i = 0; i < nkept; i++)
+                close(kept[i]);
+            run_procsub(ps->cmd);
+        }
+        close(theirs);
+        kept[nkept++] = ours;
+
+        char devpath[32];
+        snprintf(devpath, sizeof(devpath), "/dev/fd/%d", ours);
+        char **slot = (ps->argi == PROCSUB_INFILE)    ? &c->infile
+                      : (ps->argi == PROCSUB_OUTFILE) ? &c->outfile
+                                                      : &c->argv[ps->argi];
+        free(*slot);
+        *slot = strdup(devpath);
     }
+    free(kept);
+}
+
+/* Set up a stage in its child and exec it. Never returns. */
+static void exec_stage(command_t *c, const char *path)
+{
+    char *found = NULL;
+    if (c->subs)
+        start_procsubs(c);
+    /* nested pipelines resolve their own commands */
+    if (!path && c->argv && c->argv[0] && !filecmd_supported(c->argv) &&
+        !xargs_supported(c->argv))
+        path = found = which_in_path(c->argv[0]);
+    exec_single(c, path);
+    free(found);
+    _exit(127);
+}
 
+/* Fork the n stages of pipeline cmd, connected by pipes, into process
+ * group pgid (0: the first stage leads a new group). pids receives the
+ * stage pids (0 where fork failed). paths are the resolved executables,
+ * or NULL to look them up in each child. childmask is the signal mask the
+ * children should run with. If outfd >= 0 every stage's stderr and the
+ * last stage's stdout go there (before any redirections). If errfds is
+ * not NULL it receives the read end of each stage's exec error pipe (-1
+ * if none), for collect_exec_error() once the stage has exited.
+ */
+static void spawn_stages(command_t *cmd, int n, pid_t pgid, pid_t *pids,
+                         char **paths, const job_limits_t *limits,
+                         const sigset_t *childmask, int outfd, int *errfds)
+{
     /* allocate pipes array as pointer-to-int[2] */
     int **pipesfds = NULL;
     if (n > 1)
@@ -134,9 +423,8 @@ int execute_pipeline(command_t *cmd, int background, const char *rawline)
         pipesfds = calloc(n - 1, sizeof(int *));
         if (!pipesfds)
         {
-            free(pids);
             perror("calloc");
-            return -1;
+            return;
         }
         for (int i = 0; i < n - 1; ++i)
         {
@@ -151,10 +439,25 @@ int execute_pipeline(command_t *cmd, int background, const char *rawline)
     int idx = 0;
     for (command_t *c = cmd; c; c = c->next, ++idx)
     {
+        int ep[2] = {-1, -1};
+        if (errfds && pipe(ep) == 0)
+        {
+            fcntl(ep[0], F_SETFD, FD_CLOEXEC);
+            fcntl(ep[1], F_SETFD, FD_CLOEXEC);
+            fcntl(ep[0], F_SETFL, O_NONBLOCK);
+        }
+
         pid_t pid = fork();
         if (pid < 0)
         {
             perror("fork");
+            if (ep[0] >= 0)
+            {
+                close(ep[0]);
+                close(ep[1]);
+            }
+            if (errfds)
+                errfds[idx] = -1;
             /* cleanup here if you prefer */
             continue;
         }
@@ -163,9 +466,15 @@ int execute_pipeline(command_t *cmd, int background, const char *rawline)
         {
             /* child */
             signal(SIGINT, SIG_DFL);
+            sigprocmask(SIG_SETMASK, childmask, NULL);
+            if (ep[0] >= 0)
+                close(ep[0]);
+            exec_err_fd = ep[1];
 
-            /* process group: leader is first child's pid */
-            if (idx == 0)
+            /* process group: given, or led by the first child */
+            if (pgid)
+                setpgid(0, pgid);
+            else if (idx == 0)
                 setpgid(0, 0);
             else
                 setpgid(0, pids[0]);
@@ -181,6 +490,15 @@ int execute_pipeline(command_t *cmd, int background, const char *rawline)
                 dup2(pipesfds[idx][1], STDOUT_FILENO);
             }
 
+            /* captured output */
+            if (outfd >= 0)
+            {
+                if (!c->next)
+                    dup2(outfd, STDOUT_FILENO);
+                dup2(outfd, STDERR_FILENO);
+                close(outfd);
+            }
+
             /* close all pipe fds in child */
             if (pipesfds)
             {
@@ -191,13 +509,33 @@ int execute_pipeline(command_t *cmd, int background, const char *rawline)
                 }
             }
 
-            exec_single(c);
-            _exit(127);
+            /* resource limits are inherited across execv() */
+            if (apply_limits(limits) < 0)
+                _exit(126);
+
+            if (c->replicas > 1)
+            {
+                /* redirections apply to the merged stage, not each worker */
+                apply_redirs(c);
+                free(c->infile);
+                free(c->outfile);
+                c->infile = c->outfile = NULL;
+                exec_report_done();
+                run_replicated(c, paths ? paths[idx] : NULL, exec_stage);
+            }
+            exec_stage(c, paths ? paths[idx] : NULL);
         }
         else
         {
             /* parent */
-            if (idx == 0)
+            STATS_INC(ST_FORKS);
+            if (ep[1] >= 0)
+                close(ep[1]);
+            if (errfds)
+                errfds[idx] = ep[0];
+            if (pgid)
+                setpgid(pid, pgid);
+            else if (idx == 0)
                 setpgid(pid, pid);
             else
                 setpgid(pid, pids[0]);
@@ -216,30 +554,149 @@ int execute_pipeline(command_t *cmd, int background, const char *rawline)
         }
         free(pipesfds);
     }
+}
+
+/* Execute a pipeline (possibly single command). If background == 1, do not wait.
+ * rawline is used for job listing.
+ */
+int execute_pipeline(command_t *cmd, int background, const char *rawline,
+                     const job_limits_t *limits, const job_timeout_t *tmo)
+{
+    if (!cmd)
+        return -1;
+
+    /* builtin cat/cp in the foreground: no fork at all */
+    if (!background && !limits && !tmo && can_inline(cmd))
+        return run_filecmd_inline(cmd);
+
+    /* count commands */
+    int n = 0;
+    for (command_t *c = cmd; c; c = c->next)
+        n++;
+
+    pid_t *pids = calloc(n, sizeof(pid_t));
+    char **paths = calloc(n, sizeof(char *));
+    int *errfds = calloc(n, sizeof(int));
+    if (!pids || !paths || !errfds)
+    {
+        perror("calloc");
+        free(pids);
+        free(paths);
+        free(errfds);
+        return -1;
+    }
+
+    /* resolve executables once in the parent, where the lookups are counted */
+    int idx = 0;
+    for (command_t *c = cmd; c; c = c->next, ++idx)
+    {
+        if (!c->argv || !c->argv[0] || filecmd_supported(c->argv) ||
+            xargs_supported(c->argv))
+            continue;
+        paths[idx] = which_in_path(c->argv[0]);
+    }
+
+    /* Hold SIGCHLD until the job is registered or waited for, so the
+     * handler's reap_jobs() cannot steal our children's exit statuses.
+     */
+    sigset_t chld, oldmask;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &oldmask);
+
+    /* background output goes to a ring buffer instead of the terminal */
+    capture_t *cap = NULL;
+    if (background && jobs_capture_size())
+    {
+        cap = capture_open(jobs_capture_size());
+        if (!cap)
+            perror("osh: capture");
+    }
+
+    spawn_stages(cmd, n, 0, pids, paths, limits, &oldmask,
+                 cap ? capture_child_fd(cap) : -1, errfds);
+
+    free_paths(paths, n);
+    if (cap)
+        capture_spawned(cap);
 
     pid_t pgid = pids[0];
+    if (pgid <= 0)
+    {
+        sigprocmask(SIG_SETMASK, &oldmask, NULL);
+        capture_free(cap);
+        for (int i = 1; i < n; ++i)
+            collect_exec_error(errfds[i]);
+        free(errfds);
+        free(pids);
+        return -1;
+    }
+
+    /* one shared timer wheel serves every timed job */
+    if (tmo)
+        timeout_arm(pgid, tmo);
 
     if (background)
     {
-        add_job(pgid, rawline, JOB_RUNNING);
+        add_job(pgid, pids, n, rawline, JOB_RUNNING, limits);
+        if (cap)
+            job_attach_capture(pgid, cap);
+        job_attach_exec_errors(pgid, errfds);
         printf("[bg] %d\n", pgid);
+        fflush(stdout);
+        sigprocmask(SIG_SETMASK, &oldmask, NULL);
+        free(errfds);
         free(pids);
         return 0;
     }
 
     /* put job in foreground */
+    uint64_t t0 = stats_now_ns();
     tcsetpgrp(STDIN_FILENO, pgid);
 
-    int status = 0;
+    int *statuses = calloc(n, sizeof(int));
+    int stopped = 0;
     for (int i = 0; i < n; ++i)
-        waitpid(pids[i], &status, WUNTRACED);
+    {
+        int status = 0;
+        if (pids[i] > 0 && wait_child(pids[i], &status) > 0 && WIFSTOPPED(status))
+            stopped = status;
+        if (statuses)
+            statuses[i] = status;
+    }
 
     /* restore shell as foreground */
     tcsetpgrp(STDIN_FILENO, getpgrp());
+    stats_record(HIST_FG_WAIT, stats_now_ns() - t0);
 
-    if (WIFSTOPPED(status))
-        add_job(pgid, rawline, JOB_STOPPED);
+    int code;
+    if (stopped)
+    {
+        /* keep members that already exited marked as reaped */
+        add_job(pgid, pids, n, rawline, JOB_STOPPED, limits);
+        job_attach_exec_errors(pgid, errfds);
+        for (int i = 0; statuses && i < n; ++i)
+            if (!WIFSTOPPED(statuses[i]))
+                update_job_proc(pids[i], statuses[i]);
+        code = status_to_code(stopped);
+    }
+    else
+    {
+        for (int i = 0; i < n; ++i)
+            collect_exec_error(errfds[i]);
+        code = statuses ? status_to_code(statuses[n - 1]) : 0;
+        int expired = tmo ? timeout_expired(pgid) : 0;
+        if (expired)
+            code = expired;
+        if (tmo)
+            timeout_forget(pgid);
+    }
 
+    /* wait_child() may have consumed SIGCHLD for background jobs too */
+    reap_jobs();
+    sigprocmask(SIG_SETMASK, &oldmask, NULL);
+    free(statuses);
+    free(errfds);
     free(pids);
-    return 0;
+    return code;
 }
@@ -0,0 +1,244 @@
+// src/filecmds.c
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#include "filecmds.h"
+
+#define COPY_CHUNK (1 << 20) /* bytes per in-kernel copy call */
+#define BUF_SIZE (128 * 1024) /* userspace fallback buffer */
+
+#ifdef __linux__
+/* errors meaning "this method does not apply to these fds" */
+static int unsupported(int err)
+{
+    return err == EINVAL || err == ENOSYS || err == EXDEV ||
+           err == EOPNOTSUPP || err == EBADF || err == ESPIPE;
+}
+#endif
+
+/* Copy in_fd to out_fd from their current offsets until EOF.
+ * Tries, in order: copy_file_range (file -> file), sendfile (file -> any),
+ * splice (either end a pipe), then a plain read/write loop.
+ * Returns 0 on success, -1 with errno set on error.
+ */
+static int copy_fd(int in_fd, int out_fd)
+{
+#ifdef __linux__
+    struct stat ist, ost;
+    if (fstat(in_fd, &ist) < 0 || fstat(out_fd, &ost) < 0)
+        return -1;
+
+    if (S_ISREG(ist.st_mode) && S_ISREG(ost.st_mode))
+    {
+        ssize_t n;
+        int copied = 0;
+        while ((n = copy_file_range(in_fd, NULL, out_fd, NULL, COPY_CHUNK, 0)) > 0)
+            copied = 1;
+        if (n == 0)
+            return 0;
+        if (copied || !unsupported(errno))
+            return -1;
+    }
+
+    if (S_ISREG(ist.st_mode))
+    {
+        ssize_t n;
+        int copied = 0;
+        while ((n = sendfile(out_fd, in_fd, NULL, COPY_CHUNK)) > 0)
+            copied = 1;
+        if (n == 0)
+            return 0;
+        if (copied || !unsupported(errno))
+            return -1;
+    }
+
+    if (S_ISFIFO(ist.st_mode) || S_ISFIFO(ost.st_mode))
+    {
+        ssize_t n;
+        int copied = 0;
+        while ((n = splice(in_fd, NULL, out_fd, NULL, COPY_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE)) > 0)
+            copied = 1;
+        if (n == 0)
+            return 0;
+        if (copied || !unsupported(errno))
+            return -1;
+    }
+#endif
+
+    char *buf = malloc(BUF_SIZE);
+    if (!buf)
+        return -1;
+    ssize_t n;
+    while ((n = read(in_fd, buf, BUF_SIZE)) != 0)
+    {
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            free(buf);
+            return -1;
+        }
+        for (ssize_t off = 0; off < n;)
+        {
+            ssize_t w = write(out_fd, buf + off, n - off);
+            if (w < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                free(buf);
+                return -1;
+            }
+            off += w;
+        }
+    }
+    free(buf);
+    return 0;
+}
+
+static int builtin_cat(char **argv, int in_fd, int out_fd)
+{
+    int rc = 0;
+
+    if (!argv[1])
+    {
+        if (copy_fd(in_fd, out_fd) < 0)
+        {
+            perror("cat");
+            rc = 1;
+        }
+        return rc;
+    }
+
+    for (int i = 1; argv[i]; i++)
+    {
+        int fd = strcmp(argv[i], "-") == 0 ? in_fd : open(argv[i], O_RDONLY);
+        if (fd < 0)
+        {
+            fprintf(stderr, "cat: %s: %s\n", argv[i], strerror(errno));
+            rc = 1;
+            continue;
+        }
+        if (copy_fd(fd, out_fd) < 0)
+        {
+            fprintf(stderr, "cat: %s: %s\n", argv[i], strerror(errno));
+            rc = 1;
+        }
+        if (fd != in_fd)
+            close(fd);
+    }
+    return rc;
+}
+
+/* Copy one file to dst (a file path) */
+static int cp_file(const char *src, const char *dst)
+{
+    struct stat sst, dst_st;
+    int in = open(src, O_RDONLY);
+    if (in < 0 || fstat(in, &sst) < 0)
+    {
+        fprintf(stderr, "cp: %s: %s\n", src, strerror(errno));
+        if (in >= 0)
+            close(in);
+        return 1;
+    }
+    if (S_ISDIR(sst.st_mode))
+    {
+        fprintf(stderr, "cp: %s: is a directory\n", src);
+        close(in);
+        return 1;
+    }
+    if (stat(dst, &dst_st) == 0 && dst_st.st_dev == sst.st_dev && dst_st.st_ino == sst.st_ino)
+    {
+        fprintf(stderr, "cp: %s and %s are the same file\n", src, dst);
+        close(in);
+        return 1;
+    }
+
+    int out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, sst.st_mode & 07777);
+    if (out < 0)
+    {
+        fprintf(stderr, "cp: %s: %s\n", dst, strerror(errno));
+        close(in);
+        return 1;
+    }
+
+    int rc = 0;
+    if (copy_fd(in, out) < 0)
+    {
+        fprintf(stderr, "cp: %s: %s\n", dst, strerror(errno));
+        rc = 1;
+    }
+    close(in);
+    if (close(out) < 0 && rc == 0)
+    {
+        fprintf(stderr, "cp: %s: %s\n", dst, strerror(errno));
+        rc = 1;
+    }
+    return rc;
+}
+
+static int builtin_cp(char **argv)
+{
+    int argc = 0;
+    while (argv[argc])
+        argc++;
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: cp source... dest\n");
+        return 1;
+    }
+
+    const char *dst = argv[argc - 1];
+    struct stat st;
+    int is_dir = stat(dst, &st) == 0 && S_ISDIR(st.st_mode);
+    if (argc > 3 && !is_dir)
+    {
+        fprintf(stderr, "cp: target %s is not a directory\n", dst);
+        return 1;
+    }
+    if (!is_dir)
+        return cp_file(argv[1], dst);
+
+    int rc = 0;
+    for (int i = 1; i < argc - 1; i++)
+    {
+        char path[PATH_MAX];
+        char *tmp = strdup(argv[i]);
+        if (!tmp)
+            return 1;
+        snprintf(path, sizeof(path), "%s/%s", dst, basename(tmp));
+        free(tmp);
+        rc |= cp_file(argv[i], path);
+    }
+    return rc;
+}
+
+int filecmd_supported(char **argv)
+{
+    if (!argv || !argv[0])
+        return 0;
+    if (strcmp(argv[0], "cat") != 0 && strcmp(argv[0], "cp") != 0)
+        return 0;
+    /* options are left to the real programs */
+    for (int i = 1; argv[i]; i++)
+        if (argv[i][0] == '-' && argv[i][1] != '\0')
+            return 0;
+    return 1;
+}
+
+int filecmd_run(char **argv, int in_fd, int out_fd)
+{
+    if (strcmp(argv[0], "cat") == 0)
+        return builtin_cat(argv, in_fd, out_fd);
+    return builtin_cp(argv);
+}
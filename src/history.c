@@ -0,0 +1,639 @@
+// src/history.c
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "history.h"
+
+/* One index record per entry. key holds the entry's first bytes so prefix
+ * searches can skip most entries without touching the log.
+ */
+typedef struct
+{
+    uint64_t off; /* start of the entry in the log */
+    uint32_t len; /* length without the '\n' */
+    char key[4];  /* first bytes of the entry, zero padded */
+} hist_rec_t;
+
+#define REBUILD_BATCH 4096 /* records written per write() when rebuilding */
+
+/* Search index: a chained hash over every entry's trigrams and its first
+ * 1-4 bytes. <log>.gram holds a head per bucket (newest posting and the
+ * chain length); <log>.post holds the postings, each naming its entry and
+ * the previous posting in the same bucket. Chains run newest first, so
+ * !prefix stops at its first hit and history -g only walks the rarest
+ * bucket among the search string's trigrams.
+ */
+#define GRAM_BUCKETS (1u << 16)
+#define GRAM_MAGIC "oshgram1"
+
+typedef struct
+{
+    uint32_t last;  /* newest posting number + 1, 0 if empty */
+    uint32_t count; /* postings in the chain */
+} gram_head_t;
+
+typedef struct
+{
+    uint32_t entry; /* index record number */
+    uint32_t prev;  /* previous posting number + 1 in this bucket, or 0 */
+} gram_post_t;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t entries; /* entries indexed so far */
+    uint32_t posts;   /* postings in use */
+    uint32_t busy;    /* set while heads are being updated */
+    uint32_t pad;
+    gram_head_t heads[GRAM_BUCKETS];
+} gram_file_t;
+
+static int log_fd = -1;
+static int idx_fd = -1;
+static int gram_fd = -1;
+static int post_fd = -1;
+static const char *log_map;
+static size_t log_mapped;
+static const hist_rec_t *idx_map;
+static size_t idx_mapped;
+static gram_file_t *gram; /* mapped read-write, or NULL if unavailable */
+static const gram_post_t *post_map;
+static size_t post_mapped;
+
+/* (Re)map fd if its size changed since the last call */
+static int map_file(int fd, const void **map, size_t *mapped)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        return -1;
+    size_t size = (size_t)st.st_size;
+    if (size == *mapped)
+        return 0;
+
+    if (*map)
+        munmap((void *)*map, *mapped);
+    *map = NULL;
+    *mapped = 0;
+    if (size == 0)
+        return 0;
+    void *m = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED)
+        return -1;
+    *map = m;
+    *mapped = size;
+    return 0;
+}
+
+/* Index first: a record is written only after its log text, so the log
+ * mapped afterwards always covers every record we can see.
+ */
+static int refresh(void)
+{
+    if (log_fd < 0)
+        return -1;
+    if (map_file(idx_fd, (const void **)&idx_map, &idx_mapped) < 0 ||
+        map_file(log_fd, (const void **)&log_map, &log_mapped) < 0)
+        return -1;
+    if (gram && map_file(post_fd, (const void **)&post_map, &post_mapped) < 0)
+        return -1;
+    return 0;
+}
+
+static size_t count(void)
+{
+    size_t n = idx_mapped / sizeof(hist_rec_t);
+    /* another shell may have indexed lines our log map does not cover yet */
+    while (n > 0 && idx_map[n - 1].off + idx_map[n - 1].len >= log_mapped)
+        n--;
+    return n;
+}
+
+static hist_rec_t make_rec(uint64_t off, const char *text, size_t len)
+{
+    hist_rec_t r;
+    memset(&r, 0, sizeof(r));
+    r.off = off;
+    r.len = (uint32_t)len;
+    memcpy(r.key, text, len < sizeof(r.key) ? len : sizeof(r.key));
+    return r;
+}
+
+static uint32_t gram_bucket(uint32_t tag, const char *s, size_t n)
+{
+    uint32_t h = 2166136261u ^ tag; /* FNV-1a */
+    h *= 16777619u;
+    for (size_t i = 0; i < n; i++)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h & (GRAM_BUCKETS - 1);
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* The distinct buckets of text: its 1-4 byte prefixes (tagged with their
+ * length) and its trigrams (tag 0). Returns their number, or -1.
+ */
+static long entry_buckets(const char *text, size_t len, uint32_t **out, size_t *cap)
+{
+    if (*cap < len + 4)
+    {
+        uint32_t *nb = realloc(*out, (len + 4) * sizeof(uint32_t));
+        if (!nb)
+            return -1;
+        *out = nb;
+        *cap = len + 4;
+    }
+    size_t n = 0;
+    for (size_t k = 1; k <= 4 && k <= len; k++)
+        (*out)[n++] = gram_bucket((uint32_t)k, text, k);
+    for (size_t i = 0; i + 3 <= len; i++)
+        (*out)[n++] = gram_bucket(0, text + i, 3);
+
+    qsort(*out, n, sizeof(uint32_t), cmp_u32);
+    size_t u = 0;
+    for (size_t i = 0; i < n; i++)
+        if (u == 0 || (*out)[u - 1] != (*out)[i])
+            (*out)[u++] = (*out)[i];
+    return (long)u;
+}
+
+/* With the lock held: add postings for the entries the search index is
+ * missing. Heads are updated as postings are queued; busy marks the
+ * window in which they may point past the postings file.
+ */
+static void gram_update(void)
+{
+    size_t n = count();
+    if (!gram || gram->busy || gram->entries >= n)
+    {
+        /* the index lost entries: leave it to be rebuilt at next start */
+        if (gram && gram->entries > n)
+            gram->busy = 1;
+        return;
+    }
+
+    static uint32_t *bk;
+    static size_t bkcap;
+    gram_post_t batch[REBUILD_BATCH];
+    int nb = 0;
+    int ok = 1;
+
+    gram->busy = 1;
+    for (size_t e = gram->entries; e < n && ok; e++)
+    {
+        const hist_rec_t *r = &idx_map[e];
+        long nbk = entry_buckets(log_map + r->off, r->len, &bk, &bkcap);
+        if (nbk < 0)
+        {
+            ok = 0;
+            break;
+        }
+        for (long i = 0; i < nbk; i++)
+        {
+            gram_head_t *h = &gram->heads[bk[i]];
+            batch[nb].entry = (uint32_t)e;
+            batch[nb++].prev = h->last;
+            h->last = ++gram->posts;
+            h->count++;
+            if (nb == REBUILD_BATCH)
+            {
+                ok = write(post_fd, batch, sizeof(batch)) == (ssize_t)sizeof(batch);
+                nb = 0;
+                if (!ok)
+                    break;
+            }
+        }
+        gram->entries = (uint32_t)e + 1;
+    }
+    if (ok && nb)
+        ok = write(post_fd, batch, nb * sizeof(gram_post_t)) == (ssize_t)(nb * sizeof(gram_post_t));
+    /* on failure stay busy: searches scan, the next start rebuilds */
+    if (ok)
+        gram->busy = 0;
+    refresh();
+}
+
+/* With the lock held: map the search index, starting it afresh if it is
+ * new, from another format, or was left half-updated by a crash.
+ */
+static void gram_open(void)
+{
+    struct stat st;
+    if (fstat(gram_fd, &st) < 0)
+        return;
+    if ((size_t)st.st_size < sizeof(gram_file_t) &&
+        ftruncate(gram_fd, sizeof(gram_file_t)) < 0)
+        return;
+    void *m = mmap(NULL, sizeof(gram_file_t), PROT_READ | PROT_WRITE, MAP_SHARED, gram_fd, 0);
+    if (m == MAP_FAILED)
+        return;
+    gram = m;
+
+    uint64_t want = (uint64_t)gram->posts * sizeof(gram_post_t);
+    if (fstat(post_fd, &st) < 0 || (uint64_t)st.st_size < want ||
+        memcmp(gram->magic, GRAM_MAGIC, sizeof(gram->magic)) != 0 || gram->busy ||
+        gram->entries > count())
+    {
+        gram->busy = 1;
+        memset(gram->heads, 0, sizeof(gram->heads));
+        gram->entries = gram->posts = 0;
+        memcpy(gram->magic, GRAM_MAGIC, sizeof(gram->magic));
+        want = 0;
+    }
+    /* drop postings written after the last completed update */
+    if ((uint64_t)st.st_size != want && ftruncate(post_fd, (off_t)want) < 0)
+    {
+        munmap(gram, sizeof(gram_file_t));
+        gram = NULL;
+        return;
+    }
+    gram->busy = 0;
+    refresh();
+    gram_update();
+}
+
+/* With the lock held: make the index match the log after a crash between
+ * the two writes, a truncated file, or a missing index. Only the log past
+ * the last good record is scanned.
+ */
+static void repair(void)
+{
+    size_t n = idx_mapped / sizeof(hist_rec_t);
+    while (n > 0 && idx_map[n - 1].off + idx_map[n - 1].len >= log_mapped)
+        n--;
+    if (n * sizeof(hist_rec_t) != idx_mapped && ftruncate(idx_fd, (off_t)(n * sizeof(hist_rec_t))) < 0)
+        return;
+
+    uint64_t end = n ? idx_map[n - 1].off + idx_map[n - 1].len + 1 : 0;
+    hist_rec_t batch[REBUILD_BATCH];
+    int nb = 0;
+    const char *p = log_map + end;
+    const char *stop = log_map + log_mapped;
+    while (p < stop)
+    {
+        const char *nl = memchr(p, '\n', stop - p);
+        if (!nl)
+            break; /* unterminated last line: not an entry */
+        if (nl > p)
+            batch[nb++] = make_rec(p - log_map, p, nl - p);
+        if (nb == REBUILD_BATCH)
+        {
+            if (write(idx_fd, batch, sizeof(batch)) < 0)
+                return;
+            nb = 0;
+        }
+        p = nl + 1;
+    }
+    if (nb && write(idx_fd, batch, nb * sizeof(hist_rec_t)) < 0)
+        return;
+    refresh();
+}
+
+int history_init(void)
+{
+    const char *file = getenv("OSH_HISTFILE");
+    if (file && !*file)
+        return -1;
+    if (!file && !isatty(STDIN_FILENO))
+        return -1; /* scripts do not record history */
+
+    char path[PATH_MAX];
+    if (file)
+        snprintf(path, sizeof(path), "%s", file);
+    else
+    {
+        const char *home = getenv("HOME");
+        if (!home)
+            return -1;
+        snprintf(path, sizeof(path), "%s/.osh_history", home);
+    }
+
+    /* room for the longest suffix, ".gram" */
+    size_t base = strlen(path);
+    if (base + 5 >= sizeof(path))
+    {
+        fprintf(stderr, "osh: history: path too long\n");
+        return -1;
+    }
+
+    log_fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    strcpy(path + base, ".idx");
+    idx_fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (log_fd < 0 || idx_fd < 0)
+    {
+        perror("osh: history");
+        history_shutdown();
+        return -1;
+    }
+
+    /* the search index is optional: without it searches scan */
+    strcpy(path + base, ".gram");
+    gram_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    strcpy(path + base, ".post");
+    post_fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+
+    flock(log_fd, LOCK_EX);
+    if (refresh() == 0)
+    {
+        repair();
+        if (gram_fd >= 0 && post_fd >= 0)
+            gram_open();
+    }
+    flock(log_fd, LOCK_UN);
+    return 0;
+}
+
+void history_shutdown(void)
+{
+    if (log_map)
+        munmap((void *)log_map, log_mapped);
+    if (idx_map)
+        munmap((void *)idx_map, idx_mapped);
+    if (post_map)
+        munmap((void *)post_map, post_mapped);
+    if (gram)
+        munmap(gram, sizeof(gram_file_t));
+    log_map = NULL;
+    idx_map = NULL;
+    post_map = NULL;
+    gram = NULL;
+    log_mapped = idx_mapped = post_mapped = 0;
+    if (log_fd >= 0)
+        close(log_fd);
+    if (idx_fd >= 0)
+        close(idx_fd);
+    if (gram_fd >= 0)
+        close(gram_fd);
+    if (post_fd >= 0)
+        close(post_fd);
+    log_fd = idx_fd = gram_fd = post_fd = -1;
+}
+
+void history_add(const char *line)
+{
+    if (log_fd < 0 || !line[strspn(line, " \t")])
+        return;
+    size_t len = strlen(line);
+
+    /* one shell at a time, so log and index offsets agree */
+    flock(log_fd, LOCK_EX);
+    if (refresh() == 0)
+    {
+        repair();
+        size_t n = count();
+        const hist_rec_t *last = n ? &idx_map[n - 1] : NULL;
+        if (!last || last->len != len || memcmp(log_map + last->off, line, len) != 0)
+        {
+            uint64_t off = log_mapped;
+            struct iovec iov[3];
+            int k = 0;
+            if (off && log_map[off - 1] != '\n')
+            {
+                /* terminate a torn line left by a crash */
+                iov[k].iov_base = "\n";
+                iov[k++].iov_len = 1;
+                off++;
+            }
+            iov[k].iov_base = (void *)line;
+            iov[k++].iov_len = len;
+            iov[k].iov_base = "\n";
+            iov[k++].iov_len = 1;
+
+            if (writev(log_fd, iov, k) == (ssize_t)(off - log_mapped + len + 1))
+            {
+                hist_rec_t r = make_rec(off, line, len);
+                if (write(idx_fd, &r, sizeof(r)) < 0)
+                    perror("osh: history");
+            }
+        }
+        if (refresh() == 0)
+            gram_update();
+    }
+    flock(log_fd, LOCK_UN);
+}
+
+/* Entries the search index covers, 0 if it cannot be used right now */
+static size_t gram_covered(size_t n)
+{
+    if (!gram || gram->busy)
+        return 0;
+    return gram->entries < n ? gram->entries : n;
+}
+
+/* Posting number p (1-based), or NULL if another shell wrote it after
+ * our last refresh and it is still not mapped
+ */
+static const gram_post_t *posting(uint32_t p)
+{
+    if (p > post_mapped / sizeof(gram_post_t))
+        refresh();
+    return p <= post_mapped / sizeof(gram_post_t) ? &post_map[p - 1] : NULL;
+}
+
+static int has_prefix(size_t i, const char *prefix, size_t plen)
+{
+    const hist_rec_t *r = &idx_map[i];
+    size_t keylen = plen < 4 ? plen : 4;
+    return r->len >= plen && memcmp(r->key, prefix, keylen) == 0 &&
+           memcmp(log_map + r->off, prefix, plen) == 0;
+}
+
+/* Most recent entry (1-based) starting with prefix, or 0 */
+static size_t find_prefix(const char *prefix, size_t plen)
+{
+    size_t n = count();
+    size_t covered = gram_covered(n);
+
+    /* entries newer than the search index */
+    for (size_t i = n; i > covered; i--)
+        if (has_prefix(i - 1, prefix, plen))
+            return i;
+
+    size_t k = plen < 4 ? plen : 4;
+    uint32_t p = covered ? gram->heads[gram_bucket((uint32_t)k, prefix, k)].last : 0;
+    while (p)
+    {
+        const gram_post_t *g = posting(p);
+        if (!g)
+            break;
+        if (g->entry < covered && has_prefix(g->entry, prefix, plen))
+            return (size_t)g->entry + 1;
+        p = g->prev;
+    }
+    if (!p)
+        return 0;
+
+    /* chain not readable yet: fall back to a scan */
+    for (size_t i = covered; i > 0; i--)
+        if (has_prefix(i - 1, prefix, plen))
+            return i;
+    return 0;
+}
+
+int history_expand(const char *line, char **out)
+{
+    *out = NULL;
+    if (line[0] != '!' || !line[1] || isspace((unsigned char)line[1]) || line[1] == '=')
+        return 0;
+
+    const char *d = line + 1;
+    size_t dlen = strcspn(d, " \t");
+    size_t n = refresh() == 0 ? count() : 0;
+    size_t ev = 0;
+
+    if (d[0] == '!' && dlen == 1)
+        ev = n;
+    else if (isdigit((unsigned char)d[0]) || (d[0] == '-' && isdigit((unsigned char)d[1])))
+    {
+        char *end;
+        long v = strtol(d, &end, 10);
+        if ((size_t)(end - d) == dlen)
+            ev = v > 0 ? (size_t)v : (v < 0 && (size_t)-v <= n ? n + 1 + v : 0);
+    }
+    else if (n)
+        ev = find_prefix(d, dlen);
+
+    if (ev < 1 || ev > n)
+    {
+        fprintf(stderr, "osh: !%.*s: event not found\n", (int)dlen, d);
+        return -1;
+    }
+
+    const hist_rec_t *r = &idx_map[ev - 1];
+    const char *rest = d + dlen;
+    size_t rlen = strlen(rest);
+    *out = malloc(r->len + rlen + 1);
+    if (!*out)
+        return -1;
+    memcpy(*out, log_map + r->off, r->len);
+    memcpy(*out + r->len, rest, rlen + 1);
+    return 1;
+}
+
+static void print_entry(FILE *f, size_t i)
+{
+    const hist_rec_t *r = &idx_map[i];
+    fprintf(f, "%5zu  %.*s\n", i + 1, (int)r->len, log_map + r->off);
+}
+
+void history_print(FILE *f, size_t n)
+{
+    if (refresh() < 0)
+        return;
+    size_t total = count();
+    size_t first = (n && n < total) ? total - n : 0;
+    for (size_t i = first; i < total; i++)
+        print_entry(f, i);
+}
+
+/* Print entries first..total-1 containing str: memmem() over that part
+ * of the mapped log, then map each hit to its entry
+ */
+static void grep_scan(FILE *f, const char *str, size_t first, size_t total)
+{
+    if (first >= total)
+        return;
+    size_t slen = strlen(str);
+    const char *end = log_map + idx_map[total - 1].off + idx_map[total - 1].len;
+    const char *p = log_map + idx_map[first].off;
+    while ((p = memmem(p, end - p, str, slen)) != NULL)
+    {
+        uint64_t at = p - log_map;
+        size_t lo = first, hi = total; /* last record with off <= at */
+        while (hi - lo > 1)
+        {
+            size_t mid = (lo + hi) / 2;
+            if (idx_map[mid].off <= at)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        const hist_rec_t *r = &idx_map[lo];
+        if (r->off <= at && at + slen <= r->off + r->len)
+        {
+            print_entry(f, lo);
+            p = log_map + r->off + r->len;
+        }
+        else
+            p++; /* inside a torn, unindexed line */
+    }
+}
+
+/* Entries below covered containing str, found through the chain of the
+ * rarest trigram bucket in str. Returns 0, or -1 if the chain could not
+ * be read (nothing printed).
+ */
+static int grep_index(FILE *f, const char *str, size_t covered)
+{
+    size_t slen = strlen(str);
+    uint32_t best = gram_bucket(0, str, 3);
+    for (size_t i = 1; i + 3 <= slen; i++)
+    {
+        uint32_t b = gram_bucket(0, str + i, 3);
+        if (gram->heads[b].count < gram->heads[best].count)
+            best = b;
+    }
+
+    /* the chain runs newest first; print oldest first */
+    size_t nhits = 0, cap = 0;
+    uint32_t *hits = NULL;
+    for (uint32_t p = gram->heads[best].last; p;)
+    {
+        const gram_post_t *g = posting(p);
+        if (!g)
+        {
+            free(hits);
+            return -1;
+        }
+        const hist_rec_t *r = g->entry < covered ? &idx_map[g->entry] : NULL;
+        if (r && memmem(log_map + r->off, r->len, str, slen))
+        {
+            if (nhits == cap)
+            {
+                cap = cap ? cap * 2 : 64;
+                uint32_t *nh = realloc(hits, cap * sizeof(uint32_t));
+                if (!nh)
+                {
+                    free(hits);
+                    return -1;
+                }
+                hits = nh;
+            }
+            hits[nhits++] = g->entry;
+        }
+        p = g->prev;
+    }
+    while (nhits > 0)
+        print_entry(f, hits[--nhits]);
+    free(hits);
+    return 0;
+}
+
+void history_grep(FILE *f, const char *str)
+{
+    if (refresh() < 0 || !*str)
+        return;
+    size_t total = count();
+    size_t covered = gram_covered(total);
+
+    /* shorter strings have no trigram to look up */
+    if (strlen(str) < 3 || !covered || grep_index(f, str, covered) < 0)
+        covered = 0;
+    grep_scan(f, str, covered, total);
+}
@@ -5,24 +5,63 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/signalfd.h>
+#endif
 #include "jobs.h"
+#include "stats.h"
+#include "procstat.h"
+#include "timer.h"
+
+/* One member process of a job */
+typedef struct
+{
+    pid_t pid;
+    int status; // wait status once reaped
+    int done;   // 1 once reaped
+    proc_sample_t last; // previous /proc sample for jobs -v rates
+    int sampled;        // 1 once last is valid
+    int errfd;          // exec error pipe until reaped, or -1
+} job_proc_t;
 
 typedef struct job
 {
     int jobnum; // 1, 2, 3...
     pid_t pgid; // process group ID
+    job_proc_t *procs; // member processes in pipeline order
+    int nprocs;
     char *cmdline;
     job_state_t state;
+    job_limits_t limits; // settings from `limit` prefix (limits.set == 0 if none)
+    capture_t *out;      // captured stdout/stderr, or NULL
+    uint64_t out_pos;    // stream offset printed so far
+    int follow;          // 1 while output is printed as it arrives (fg, jobs -o -f)
     struct job *next;
 } job_t;
 
 static job_t *job_head = NULL;
 static int next_jobnum = 1;
 
+/* ring size for captured background output; 0 = off */
+static size_t capture_size = 0;
+
+/* readable when SIGCHLD is pending while blocked (foreground waits) */
+static int sigchld_fd = -1;
+
 void jobs_init(void)
 {
     job_head = NULL;
     next_jobnum = 1;
+#ifdef __linux__
+    sigset_t chld;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigchld_fd = signalfd(-1, &chld, SFD_NONBLOCK | SFD_CLOEXEC);
+#endif
 }
 
 void jobs_shutdown(void)
@@ -31,6 +70,11 @@ void jobs_shutdown(void)
     while (j)
     {
         job_t *n = j->next;
+        capture_free(j->out);
+        for (int i = 0; i < j->nprocs; i++)
+            if (j->procs[i].errfd >= 0)
+                close(j->procs[i].errfd);
+        free(j->procs);
         free(j->cmdline);
         free(j);
         j = n;
@@ -38,15 +82,43 @@ void jobs_shutdown(void)
     job_head = NULL;
 }
 
-int add_job(pid_t pgid, const char *cmdline, job_state_t state)
+int status_to_code(int wstatus)
 {
-    job_t *j = malloc(sizeof(job_t));
+    if (WIFEXITED(wstatus))
+        return WEXITSTATUS(wstatus);
+    if (WIFSIGNALED(wstatus))
+        return 128 + WTERMSIG(wstatus);
+    if (WIFSTOPPED(wstatus))
+        return 128 + WSTOPSIG(wstatus);
+    return 0;
+}
+
+int add_job(pid_t pgid, const pid_t *pids, int npids, const char *cmdline,
+            job_state_t state, const job_limits_t *limits)
+{
+    job_t *j = calloc(1, sizeof(job_t));
     if (!j)
         return -1;
+    j->procs = calloc(npids, sizeof(job_proc_t));
+    if (!j->procs)
+    {
+        free(j);
+        return -1;
+    }
+    for (int i = 0; i < npids; i++)
+    {
+        j->procs[i].pid = pids[i];
+        j->procs[i].errfd = -1;
+    }
+    j->nprocs = npids;
     j->jobnum = next_jobnum++;
     j->pgid = pgid;
     j->cmdline = strdup(cmdline);
     j->state = state;
+    if (limits)
+        j->limits = *limits;
+    else
+        memset(&j->limits, 0, sizeof(j->limits));
     j->next = job_head;
     job_head = j;
     return j->jobnum;
@@ -76,6 +148,11 @@ void remove_job(pid_t pgid)
         {
             job_t *tmp = *pp;
             *pp = tmp->next;
+            timeout_forget(pgid);
+            capture_free(tmp->out);
+            for (int i = 0; i < tmp->nprocs; i++)
+                collect_exec_error(tmp->procs[i].errfd);
+            free(tmp->procs);
             free(tmp->cmdline);
             free(tmp);
             return;
@@ -84,6 +161,42 @@ void remove_job(pid_t pgid)
     }
 }
 
+/* Record a wait status for member pid; the job is Done once every member
+ * has been reaped.
+ */
+void update_job_proc(pid_t pid, int status)
+{
+    for (job_t *j = job_head; j; j = j->next)
+    {
+        for (int i = 0; i < j->nprocs; i++)
+        {
+            if (j->procs[i].pid != pid)
+                continue;
+
+            if (WIFEXITED(status) || WIFSIGNALED(status))
+            {
+                j->procs[i].status = status;
+                j->procs[i].done = 1;
+                collect_exec_error(j->procs[i].errfd);
+                j->procs[i].errfd = -1;
+                int live = 0;
+                for (int k = 0; k < j->nprocs; k++)
+                    live += !j->procs[k].done;
+                if (!live)
+                {
+                    j->state = JOB_DONE;
+                    timeout_disarm(j->pgid);
+                }
+            }
+            else if (WIFSTOPPED(status))
+                j->state = JOB_STOPPED;
+            else if (WIFCONTINUED(status))
+                j->state = JOB_RUNNING;
+            return;
+        }
+    }
+}
+
 void reap_jobs(void)
 {
     int status;
@@ -91,29 +204,350 @@ void reap_jobs(void)
 
     while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0)
     {
-        for (job_t *j = job_head; j; j = j->next)
+        if (WIFEXITED(status) || WIFSIGNALED(status))
+            STATS_INC(ST_REAPS);
+        update_job_proc(pid, status);
+    }
+}
+
+void jobs_set_capture(size_t bytes)
+{
+    capture_size = bytes;
+}
+
+size_t jobs_capture_size(void)
+{
+    return capture_size;
+}
+
+void job_attach_capture(pid_t pgid, capture_t *c)
+{
+    for (job_t *j = job_head; j; j = j->next)
+    {
+        if (j->pgid == pgid)
+        {
+            j->out = c;
+            return;
+        }
+    }
+    capture_free(c);
+}
+
+void job_attach_exec_errors(pid_t pgid, const int *fds)
+{
+    for (job_t *j = job_head; j; j = j->next)
+    {
+        if (j->pgid == pgid)
         {
-            if (j->pgid == pid)
+            for (int i = 0; i < j->nprocs; i++)
             {
-                if (WIFEXITED(status) || WIFSIGNALED(status))
-                    j->state = JOB_DONE;
-                else if (WIFSTOPPED(status))
-                    j->state = JOB_STOPPED;
-                else if (WIFCONTINUED(status))
-                    j->state = JOB_RUNNING;
-                break;
+                j->procs[i].errfd = fds[i];
+                if (j->procs[i].done)
+                {
+                    collect_exec_error(fds[i]);
+                    j->procs[i].errfd = -1;
+                }
             }
+            return;
         }
     }
 }
 
-void list_jobs(void)
+void collect_exec_error(int fd)
+{
+    if (fd < 0)
+        return;
+    int err;
+    ssize_t r;
+    while ((r = read(fd, &err, sizeof(err))) < 0 && errno == EINTR)
+        ;
+    if (r == (ssize_t)sizeof(err))
+        STATS_INC(ST_EXEC_FAIL);
+    close(fd);
+}
+
+/* Print j's output from where we left off */
+static void print_output(job_t *j)
+{
+    uint64_t oldest = capture_oldest(j->out);
+    if (j->out_pos < oldest)
+        printf("[%d] ... %llu bytes overwritten ...\n", j->jobnum,
+               (unsigned long long)(oldest - j->out_pos));
+    fflush(stdout);
+    capture_dump(j->out, &j->out_pos, STDOUT_FILENO);
+}
+
+/* Free a finished job's ring once its output has been reported */
+static void release_output(job_t *j)
+{
+    if (!j->out || j->state != JOB_DONE || j->follow)
+        return;
+    while (capture_drain(j->out) > 0)
+        ;
+    if (capture_poll_fd(j->out) < 0)
+    {
+        capture_free(j->out);
+        j->out = NULL;
+    }
+}
+
+static void drain_captures(void)
 {
+    for (job_t *j = job_head; j; j = j->next)
+    {
+        if (j->out && capture_poll_fd(j->out) >= 0)
+        {
+            capture_drain(j->out);
+            if (j->follow)
+                print_output(j);
+        }
+    }
+}
+
+int jobs_need_poll(void)
+{
+    if (timer_pending())
+        return 1;
+    for (job_t *j = job_head; j; j = j->next)
+        if (j->out && capture_poll_fd(j->out) >= 0)
+            return 1;
+    return 0;
+}
+
+int jobs_poll(int fd, int timeout_ms)
+{
+    /* fd, the timer and one slot per open capture; kept between calls */
+    static struct pollfd *pfd;
+    static size_t pfd_cap;
+    size_t want = 2;
+    for (job_t *j = job_head; j; j = j->next)
+        if (j->out && capture_poll_fd(j->out) >= 0)
+            want++;
+    if (want > pfd_cap)
+    {
+        struct pollfd *grown = realloc(pfd, want * sizeof(struct pollfd));
+        if (!grown)
+            return -1;
+        pfd = grown;
+        pfd_cap = want;
+    }
+
+    nfds_t np = 0;
+    pfd[np].fd = fd;
+    pfd[np++].events = POLLIN;
+    pfd[np].fd = timer_pending() ? timer_fd() : -1;
+    pfd[np++].events = POLLIN;
+    for (job_t *j = job_head; j; j = j->next)
+    {
+        if (j->out && capture_poll_fd(j->out) >= 0)
+        {
+            pfd[np].fd = capture_poll_fd(j->out);
+            pfd[np++].events = POLLIN;
+        }
+    }
+
+    if (poll(pfd, np, timeout_ms) < 0)
+        return errno == EINTR ? 0 : -1;
+
+    if (pfd[1].revents & POLLIN)
+        timer_service();
+    for (nfds_t i = 2; i < np; i++)
+    {
+        if (pfd[i].revents)
+        {
+            drain_captures();
+            break;
+        }
+    }
+    return fd >= 0 && pfd[0].revents;
+}
+
+void jobs_sleep(double secs, volatile sig_atomic_t *stop)
+{
+    uint64_t end = stats_now_ns() + (uint64_t)(secs * 1e9);
+    for (;;)
+    {
+        uint64_t now = stats_now_ns();
+        if (now >= end || (stop && *stop))
+            return;
+        /* round up so we do not spin on the last partial millisecond */
+        if (jobs_poll(-1, (int)((end - now + 999999) / 1000000)) < 0)
+            return;
+    }
+}
+
+pid_t wait_child(pid_t pid, int *status)
+{
+    if (!jobs_need_poll() || sigchld_fd < 0)
+        return waitpid(pid, status, WUNTRACED);
+
+    /* sleep in poll() so the timer wheel keeps running and captured
+     * background output keeps draining
+     */
+    for (;;)
+    {
+        pid_t r = waitpid(pid, status, WUNTRACED | WNOHANG);
+        if (r != 0)
+            return r;
+        int rc = jobs_poll(sigchld_fd, -1);
+        if (rc < 0)
+            return -1;
+#ifdef __linux__
+        if (rc > 0)
+        {
+            struct signalfd_siginfo si;
+            while (read(sigchld_fd, &si, sizeof(si)) > 0)
+                STATS_INC(ST_SIGCHLD);
+        }
+#endif
+    }
+}
+
+int job_output(int jobnum, int follow, volatile sig_atomic_t *stop)
+{
+    job_t *j = job_head;
+    while (j && j->jobnum != jobnum)
+        j = j->next;
+    if (!j || !j->out)
+        return -1;
+
+    /* whatever the ring still holds, then anything new */
+    j->out_pos = 0;
+    capture_drain(j->out);
+    print_output(j);
+    if (!follow)
+    {
+        release_output(j);
+        return 0;
+    }
+
+    j->follow = 1;
+    while (!*stop && capture_poll_fd(j->out) >= 0)
+        if (jobs_poll(-1, -1) < 0)
+            break;
+    j->follow = 0;
+    release_output(j);
+    return 0;
+}
+
+int wait_job(pid_t pgid)
+{
+    job_t *j = job_head;
+    while (j && j->pgid != pgid)
+        j = j->next;
+    if (!j)
+        return -1;
+
+    /* a captured job's output shows up while it is in the foreground */
+    if (j->out)
+    {
+        capture_drain(j->out);
+        print_output(j);
+        j->follow = 1;
+    }
+
+    for (int i = 0; i < j->nprocs; i++)
+    {
+        job_proc_t *p = &j->procs[i];
+        int status;
+        if (p->done)
+            continue;
+        if (wait_child(p->pid, &status) < 0)
+        {
+            /* already reaped elsewhere; status unknown */
+            p->done = 1;
+            continue;
+        }
+        if (WIFSTOPPED(status))
+        {
+            j->state = JOB_STOPPED;
+            j->follow = 0;
+            return status_to_code(status);
+        }
+        p->status = status;
+        p->done = 1;
+    }
+
+    if (j->out)
+    {
+        while (capture_drain(j->out) > 0)
+            ;
+        print_output(j);
+    }
+
+    int code = status_to_code(j->procs[j->nprocs - 1].status);
+    int expired = timeout_expired(pgid);
+    if (expired)
+        code = expired;
+    remove_job(pgid);
+    return code;
+}
+
+int jobs_running(void)
+{
+    int n = 0;
+    for (job_t *j = job_head; j; j = j->next)
+        n += (j->state == JOB_RUNNING);
+    return n;
+}
+
+/* Print one line per live member with rates since its previous sample.
+ * Members never sampled before get a short priming interval first.
+ */
+static void list_job_procs(job_t *j)
+{
+    printf("    %-5s %-7s %-16s %s %11s %11s %7s  %s\n",
+           "stage", "pid", "command", "S", "read", "write", "cpu", "blocked");
+    for (int i = 0; i < j->nprocs; i++)
+    {
+        job_proc_t *p = &j->procs[i];
+        proc_sample_t cur;
+        if (p->done || proc_sample(p->pid, &cur) < 0)
+        {
+            printf("    %-5d %-7d (exited)\n", i, (int)p->pid);
+            continue;
+        }
+        proc_print_rates(i, p->pid, p->sampled ? &p->last : NULL, &cur);
+        p->last = cur;
+        p->sampled = 1;
+    }
+}
+
+void list_jobs(int flags)
+{
+    if (flags & JOBS_IO)
+    {
+        /* take a first sample so rates are available right away */
+        int primed = 0;
+        for (job_t *j = job_head; j; j = j->next)
+            for (int i = 0; i < j->nprocs; i++)
+            {
+                job_proc_t *p = &j->procs[i];
+                if (!p->done && !p->sampled && proc_sample(p->pid, &p->last) == 0)
+                    p->sampled = primed = 1;
+            }
+        if (primed)
+            jobs_sleep(0.1, NULL);
+    }
+
     for (job_t *j = job_head; j; j = j->next)
     {
         const char *state =
             (j->state == JOB_RUNNING) ? "Running" : (j->state == JOB_STOPPED) ? "Stopped"
                                                                               : "Done";
-        printf("[%d] %d  %s  (%s)\n", j->jobnum, j->pgid, state, j->cmdline);
+        if (timeout_expired(j->pgid))
+            state = (j->state == JOB_DONE) ? "Timed out" : "Timing out";
+        printf("[%d] %d  %s  (%s)", j->jobnum, j->pgid, state, j->cmdline);
+        if ((flags & JOBS_LONG) && j->limits.set)
+        {
+            char buf[256];
+            format_limits(&j->limits, buf, sizeof(buf));
+            printf("  [%s]", buf);
+        }
+        printf("\n");
+        if ((flags & JOBS_IO) && j->state != JOB_DONE)
+            list_job_procs(j);
+        release_output(j);
     }
+    fflush(stdout);
 }
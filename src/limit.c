@@ -0,0 +1,291 @@
+// src/limit.c
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include "limit.h"
+
+#define WORD_BITS (8 * sizeof(unsigned long))
+
+/* Parse a cpu list like "0-7,12,14-15" into lim->cpumask */
+static int parse_cpulist(const char *s, job_limits_t *lim)
+{
+    const char *p = s;
+    memset(lim->cpumask, 0, sizeof(lim->cpumask));
+
+    while (*p)
+    {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p || lo < 0)
+            return -1;
+        long hi = lo;
+        p = end;
+        if (*p == '-')
+        {
+            p++;
+            hi = strtol(p, &end, 10);
+            if (end == p || hi < lo)
+                return -1;
+            p = end;
+        }
+        if (hi >= LIMIT_MAX_CPUS)
+            return -1;
+        for (long c = lo; c <= hi; c++)
+            lim->cpumask[c / WORD_BITS] |= 1UL << (c % WORD_BITS);
+        if (*p == ',')
+            p++;
+        else if (*p)
+            return -1;
+    }
+    return 0;
+}
+
+/* Parse a plain decimal count into *v; *end is left at the first byte
+ * after the digits. Values must stay below RLIM_INFINITY.
+ */
+static int parse_number(const char *s, char **end, unsigned long long *v)
+{
+    if (*s < '0' || *s > '9')
+        return -1; /* strtoull() would accept a sign and wrap "-1" */
+    errno = 0;
+    *v = strtoull(s, end, 10);
+    if (errno || *v >= (unsigned long long)RLIM_INFINITY)
+        return -1;
+    return 0;
+}
+
+/* Parse a size with optional K/M/G/T suffix (powers of 1024) */
+int parse_size(const char *s, rlim_t *out)
+{
+    char *end;
+    unsigned long long v;
+    if (parse_number(s, &end, &v) < 0)
+        return -1;
+    int shift = 0;
+    switch (*end)
+    {
+    case 'T':
+    case 't':
+        shift += 10;
+        /* fallthrough */
+    case 'G':
+    case 'g':
+        shift += 10;
+        /* fallthrough */
+    case 'M':
+    case 'm':
+        shift += 10;
+        /* fallthrough */
+    case 'K':
+    case 'k':
+        shift += 10;
+        end++;
+        break;
+    case '\0':
+        break;
+    default:
+        return -1;
+    }
+    if (*end || v > ((unsigned long long)RLIM_INFINITY - 1) >> shift)
+        return -1;
+    *out = (rlim_t)(v << shift);
+    return 0;
+}
+
+/* Parse a plain count, no suffixes */
+static int parse_count(const char *s, rlim_t *out)
+{
+    char *end;
+    unsigned long long v;
+    if (parse_number(s, &end, &v) < 0 || *end)
+        return -1;
+    *out = (rlim_t)v;
+    return 0;
+}
+
+int parse_limits(char **argv, job_limits_t *lim)
+{
+    memset(lim, 0, sizeof(*lim));
+
+    int i = 1;
+    while (argv[i] && strncmp(argv[i], "--", 2) == 0)
+    {
+        const char *opt = argv[i];
+        const char *val = argv[i + 1];
+        if (!val)
+        {
+            fprintf(stderr, "limit: missing value for %s\n", opt);
+            return -1;
+        }
+
+        if (strcmp(opt, "--cpus") == 0)
+        {
+            if (strlen(val) >= sizeof(lim->cpulist) || parse_cpulist(val, lim) < 0)
+            {
+                fprintf(stderr, "limit: bad cpu list '%s'\n", val);
+                return -1;
+            }
+            strcpy(lim->cpulist, val);
+            lim->set |= LIMIT_CPUS;
+        }
+        else if (strcmp(opt, "--nice") == 0)
+        {
+            char *end;
+            long n = strtol(val, &end, 10);
+            if (end == val || *end || n < -20 || n > 19)
+            {
+                fprintf(stderr, "limit: bad nice value '%s'\n", val);
+                return -1;
+            }
+            lim->nice = (int)n;
+            lim->set |= LIMIT_NICE;
+        }
+        else if (strcmp(opt, "--mem") == 0)
+        {
+            if (parse_size(val, &lim->mem) < 0)
+            {
+                fprintf(stderr, "limit: bad memory size '%s'\n", val);
+                return -1;
+            }
+            lim->set |= LIMIT_MEM;
+        }
+        else if (strcmp(opt, "--nofile") == 0)
+        {
+            if (parse_count(val, &lim->nofile) < 0)
+            {
+                fprintf(stderr, "limit: bad file count '%s'\n", val);
+                return -1;
+            }
+            lim->set |= LIMIT_NOFILE;
+        }
+        else
+        {
+            fprintf(stderr, "limit: unknown option %s\n", opt);
+            return -1;
+        }
+        i += 2;
+    }
+
+    if (!argv[i])
+    {
+        fprintf(stderr, "Usage: limit [--cpus LIST] [--nice N] [--mem SIZE] [--nofile N] command\n");
+        return -1;
+    }
+#ifndef __linux__
+    if (lim->set & LIMIT_CPUS)
+    {
+        fprintf(stderr, "limit: --cpus is not supported on this platform\n");
+        return -1;
+    }
+#endif
+    return i;
+}
+
+/* Set soft and hard limit; if raising the hard limit is not permitted,
+ * fall back to setting only the soft limit.
+ */
+static int set_rlimit(int resource, rlim_t value, const char *name)
+{
+    struct rlimit rl = {value, value};
+    if (setrlimit(resource, &rl) == 0)
+        return 0;
+    if (errno == EPERM && getrlimit(resource, &rl) == 0 &&
+        (rl.rlim_max == RLIM_INFINITY || value <= rl.rlim_max))
+    {
+        rl.rlim_cur = value;
+        if (setrlimit(resource, &rl) == 0)
+            return 0;
+    }
+    fprintf(stderr, "limit: setrlimit %s: %s\n", name, strerror(errno));
+    return -1;
+}
+
+int apply_limits(const job_limits_t *lim)
+{
+    if (!lim || !lim->set)
+        return 0;
+
+    if ((lim->set & LIMIT_MEM) && set_rlimit(RLIMIT_AS, lim->mem, "mem") < 0)
+        return -1;
+    if ((lim->set & LIMIT_NOFILE) && set_rlimit(RLIMIT_NOFILE, lim->nofile, "nofile") < 0)
+        return -1;
+
+    if ((lim->set & LIMIT_NICE) && setpriority(PRIO_PROCESS, 0, lim->nice) < 0)
+    {
+        perror("limit: setpriority");
+        return -1;
+    }
+
+#ifdef __linux__
+    if (lim->set & LIMIT_CPUS)
+    {
+        cpu_set_t *set = CPU_ALLOC(LIMIT_MAX_CPUS);
+        size_t sz = CPU_ALLOC_SIZE(LIMIT_MAX_CPUS);
+        if (!set)
+        {
+            perror("limit: CPU_ALLOC");
+            return -1;
+        }
+        CPU_ZERO_S(sz, set);
+        for (int c = 0; c < LIMIT_MAX_CPUS; c++)
+            if (lim->cpumask[c / WORD_BITS] & (1UL << (c % WORD_BITS)))
+                CPU_SET_S(c, sz, set);
+        int rc = sched_setaffinity(0, sz, set);
+        CPU_FREE(set);
+        if (rc < 0)
+        {
+            perror("limit: sched_setaffinity");
+            return -1;
+        }
+    }
+#endif
+    return 0;
+}
+
+/* Print a size using the largest exact K/M/G/T suffix */
+static void format_size(rlim_t v, char *buf, size_t len)
+{
+    const char *sfx = "KMGT";
+    int s = -1;
+    while (s < 3 && v && (v & 1023) == 0)
+    {
+        v >>= 10;
+        s++;
+    }
+    if (s < 0)
+        snprintf(buf, len, "%llu", (unsigned long long)v);
+    else
+        snprintf(buf, len, "%llu%c", (unsigned long long)v, sfx[s]);
+}
+
+void format_limits(const job_limits_t *lim, char *buf, size_t len)
+{
+    char num[32];
+    size_t off = 0;
+
+    buf[0] = '\0';
+    if (!lim || !lim->set)
+        return;
+
+    if ((lim->set & LIMIT_CPUS) && off < len)
+        off += snprintf(buf + off, len - off, "cpus=%s ", lim->cpulist);
+    if ((lim->set & LIMIT_NICE) && off < len)
+        off += snprintf(buf + off, len - off, "nice=%d ", lim->nice);
+    if ((lim->set & LIMIT_MEM) && off < len)
+    {
+        format_size(lim->mem, num, sizeof(num));
+        off += snprintf(buf + off, len - off, "mem=%s ", num);
+    }
+    if ((lim->set & LIMIT_NOFILE) && off < len)
+        off += snprintf(buf + off, len - off, "nofile=%llu ", (unsigned long long)lim->nofile);
+
+    /* drop trailing space */
+    if (off > 0 && off <= len)
+        buf[off - 1] = '\0';
+}
@@ -5,6 +5,8 @@
 #include <ctype.h>
 #include <stdio.h>
 #include "shell.h"
+#include "stats.h"
+#include "limit.h"
 
 /* Allocate safe duplicate */
 static char *strdup_safe(const char *s)
@@ -17,11 +19,202 @@ static char *strdup_safe(const char *s)
     return r;
 }
 
+/* Given p at "<(" or ">(", return a pointer just past the matching ')',
+ * or NULL if it is unmatched. Quotes and nested parens are skipped.
+ */
+static const char *skip_procsub(const char *p)
+{
+    int depth = 0;
+    p++; /* at '(' */
+    while (*p)
+    {
+        if (*p == '"' || *p == '\'')
+        {
+            char q = *p++;
+            while (*p && *p != q)
+                p++;
+            if (!*p)
+                return NULL;
+        }
+        else if (*p == '(')
+            depth++;
+        else if (*p == ')' && --depth == 0)
+            return p + 1;
+        p++;
+    }
+    return NULL;
+}
+
+/* === COMMAND LISTS (; & && ||) ========================================== */
+
+/* Append a list entry for line[start, end) with the given connector */
+static int list_push(cmdlist_t **head, cmdlist_t **tail, const char *start,
+                     const char *end, list_op_t op, int background)
+{
+    while (start < end && isspace((unsigned char)*start))
+        start++;
+    while (end > start && isspace((unsigned char)end[-1]))
+        end--;
+
+    cmdlist_t *e = calloc(1, sizeof(cmdlist_t));
+    if (!e)
+    {
+        perror("calloc");
+        return -1;
+    }
+    e->text = strndup(start, end - start);
+    e->op = op;
+    e->background = background;
+    if (*tail)
+        (*tail)->next = e;
+    else
+        *head = e;
+    *tail = e;
+    return 0;
+}
+
+cmdlist_t *split_list(const char *line)
+{
+    if (!line)
+        return NULL;
+
+    cmdlist_t *head = NULL;
+    cmdlist_t *tail = NULL;
+    list_op_t op = LIST_SEQ;
+    const char *start = line;
+    const char *p = line;
+
+    while (*p)
+    {
+        /* skip quoted text; unmatched quotes are reported by the tokenizer */
+        if (*p == '"' || *p == '\'')
+        {
+            char q = *p++;
+            while (*p && *p != q)
+            {
+                if (q == '"' && *p == '\\' && p[1] == '"')
+                    p++;
+                p++;
+            }
+            if (*p)
+                p++;
+            continue;
+        }
+
+        /* a process substitution is one word, whatever it contains */
+        if ((*p == '<' || *p == '>') && p[1] == '(')
+        {
+            const char *end = skip_procsub(p);
+            p = end ? end : p + 2;
+            continue;
+        }
+
+        int oplen = 0;
+        list_op_t next_op = LIST_SEQ;
+        int background = 0;
+        if (*p == '&' && p[1] == '&')
+        {
+            oplen = 2;
+            next_op = LIST_AND;
+        }
+        else if (*p == '|' && p[1] == '|')
+        {
+            oplen = 2;
+            next_op = LIST_OR;
+        }
+        else if (*p == '&')
+        {
+            oplen = 1;
+            background = 1;
+        }
+        else if (*p == ';')
+        {
+            oplen = 1;
+        }
+
+        if (!oplen)
+        {
+            p++;
+            continue;
+        }
+
+        /* an operator must follow a non-empty pipeline */
+        const char *q = start;
+        while (q < p && isspace((unsigned char)*q))
+            q++;
+        if (q == p)
+        {
+            fprintf(stderr, "osh: syntax error near unexpected token '%.*s'\n", oplen, p);
+            free_cmdlist(head);
+            return NULL;
+        }
+
+        if (list_push(&head, &tail, start, p, op, background) < 0)
+        {
+            free_cmdlist(head);
+            return NULL;
+        }
+        op = next_op;
+        p += oplen;
+        start = p;
+    }
+
+    /* trailing pipeline; may be empty only after ';' or '&' */
+    const char *q = start;
+    while (*q && isspace((unsigned char)*q))
+        q++;
+    if (*q)
+    {
+        if (list_push(&head, &tail, start, p, op, 0) < 0)
+        {
+            free_cmdlist(head);
+            return NULL;
+        }
+    }
+    else if (op != LIST_SEQ)
+    {
+        fprintf(stderr, "osh: syntax error: expected command after '%s'\n",
+                op == LIST_AND ? "&&" : "||");
+        free_cmdlist(head);
+        return NULL;
+    }
+
+    return head;
+}
+
+void free_cmdlist(cmdlist_t *l)
+{
+    while (l)
+    {
+        cmdlist_t *next = l->next;
+        free(l->text);
+        free(l);
+        l = next;
+    }
+}
+
 /* === TOKENIZATION WITH QUOTES & ESCAPES ================================== */
 
+/* Expand $? into buf at *bi if p points at it. Returns chars consumed. */
+static int expand_status(const char *p, char *buf, int *bi, int cap)
+{
+    if (p[0] != '$' || p[1] != '?')
+        return 0;
+    int n = snprintf(buf + *bi, cap - *bi, "%d", last_status);
+    if (n > 0)
+        *bi += (n < cap - *bi) ? n : cap - *bi - 1;
+    return 2;
+}
+
+/* token kinds */
+#define TOK_WORD 0
+#define TOK_PROCSUB 1 /* "<(...)" or ">(...)"; text is the whole construct */
+#define TOK_REPLICATE 2 /* "|[N,opts]" */
+
 typedef struct
 {
     char **items;
+    int *kinds;
     int count;
     int cap;
 } token_list_t;
@@ -29,25 +222,34 @@ typedef struct
 static void tokens_init(token_list_t *t)
 {
     t->items = NULL;
+    t->kinds = NULL;
     t->count = 0;
     t->cap = 0;
 }
 
-static void tokens_push(token_list_t *t, char *tok)
+static void tokens_push_kind(token_list_t *t, char *tok, int kind)
 {
     if (t->count + 1 >= t->cap)
     {
         t->cap = t->cap ? t->cap * 2 : 8;
         t->items = realloc(t->items, sizeof(char *) * t->cap);
+        t->kinds = realloc(t->kinds, sizeof(int) * t->cap);
     }
+    t->kinds[t->count] = kind;
     t->items[t->count++] = tok;
 }
 
+static void tokens_push(token_list_t *t, char *tok)
+{
+    tokens_push_kind(t, tok, TOK_WORD);
+}
+
 static void tokens_free(token_list_t *t)
 {
     for (int i = 0; i < t->count; i++)
         free(t->items[i]);
     free(t->items);
+    free(t->kinds);
 }
 
 /* Tokenizer that handles quotes and escapes */
@@ -78,6 +280,10 @@ static int tokenize(const char *line, token_list_t *out)
                     buf[bi++] = '"';
                     p += 2;
                 }
+                else if (*p == '$' && p[1] == '?')
+                {
+                    p += expand_status(p, buf, &bi, sizeof(buf));
+                }
                 else
                 {
                     buf[bi++] = *p++;
@@ -116,6 +322,34 @@ static int tokenize(const char *line, token_list_t *out)
             tokens_push(out, strdup_safe(buf));
         }
 
+        /* process substitution: <(pipeline) or >(pipeline) */
+        else if ((*p == '<' || *p == '>') && p[1] == '(')
+        {
+            const char *end = skip_procsub(p);
+            if (!end)
+            {
+                fprintf(stderr, "osh: unmatched '%c('\n", *p);
+                tokens_free(out);
+                return -1;
+            }
+            tokens_push_kind(out, strndup(p, end - p), TOK_PROCSUB);
+            p = end;
+        }
+
+        /* replicated stage: |[N,ordered,nul] */
+        else if (*p == '|' && p[1] == '[')
+        {
+            const char *end = strchr(p, ']');
+            if (!end)
+            {
+                fprintf(stderr, "osh: unmatched '|['\n");
+                tokens_free(out);
+                return -1;
+            }
+            tokens_push_kind(out, strndup(p, end + 1 - p), TOK_REPLICATE);
+            p = end + 1;
+        }
+
         /* special tokens */
         else if (*p == '|' || *p == '<' || *p == '>')
         {
@@ -142,7 +376,10 @@ static int tokenize(const char *line, token_list_t *out)
                    *p != '|' && *p != '<' && *p != '>' &&
                    *p != '\'' && *p != '"')
             {
-                buf[bi++] = *p++;
+                if (*p == '$' && p[1] == '?')
+                    p += expand_status(p, buf, &bi, sizeof(buf));
+                else
+                    buf[bi++] = *p++;
             }
             buf[bi] = '\0';
             tokens_push(out, strdup_safe(buf));
@@ -153,7 +390,78 @@ static int tokenize(const char *line, token_list_t *out)
 
 /* === PARSE TOKENS INTO COMMAND STRUCTURES ================================ */
 
-command_t *parse_line(const char *line)
+static command_t *parse_tokens(const char *line);
+
+/* Record that word slot argi of cur (or PROCSUB_INFILE/OUTFILE) is the
+ * process substitution tok ("<(...)" or ">(...)"). Returns 0 or -1.
+ */
+static int add_procsub(command_t *cur, const char *tok, int argi)
+{
+    size_t len = strlen(tok);
+    char *inner = strndup(tok + 2, len - 3);
+    if (!inner)
+        return -1;
+    command_t *sub = parse_tokens(inner);
+    free(inner);
+    if (!sub)
+    {
+        fprintf(stderr, "osh: empty process substitution '%s'\n", tok);
+        return -1;
+    }
+
+    procsub_t *ps = calloc(1, sizeof(procsub_t));
+    if (!ps)
+    {
+        free_command_chain(sub);
+        return -1;
+    }
+    ps->argi = argi;
+    ps->dir = tok[0];
+    ps->cmd = sub;
+    ps->next = cur->subs;
+    cur->subs = ps;
+    return 0;
+}
+
+/* Parse "|[N,ordered,nul,chunk=SIZE]" into a replica count, REP_* flags
+ * and chunk size
+ */
+static int parse_replicate(const char *tok, int *replicas, int *flags, size_t *chunk)
+{
+    char *spec = strndup(tok + 2, strlen(tok) - 3);
+    if (!spec)
+        return -1;
+
+    int rc = 0;
+    char *save;
+    char *end;
+    char *f = strtok_r(spec, ",", &save);
+    long n = f ? strtol(f, &end, 10) : 0;
+    if (!f || end == f || *end || n < 1 || n > 256)
+        rc = -1;
+    *replicas = (int)n;
+    *flags = 0;
+    *chunk = 0;
+    while (rc == 0 && (f = strtok_r(NULL, ",", &save)))
+    {
+        rlim_t sz;
+        if (strcmp(f, "ordered") == 0)
+            *flags |= REP_ORDERED;
+        else if (strcmp(f, "nul") == 0)
+            *flags |= REP_NUL;
+        else if (strncmp(f, "chunk=", 6) == 0 && parse_size(f + 6, &sz) == 0 &&
+                 sz >= 1024 && sz <= (1ull << 30))
+            *chunk = (size_t)sz;
+        else
+            rc = -1;
+    }
+    if (rc < 0)
+        fprintf(stderr, "osh: bad replicated stage '%s' (want |[N,ordered,nul,chunk=SIZE], SIZE 1K-1G)\n", tok);
+    free(spec);
+    return rc;
+}
+
+static command_t *parse_tokens(const char *line)
 {
     if (!line)
         return NULL;
@@ -170,6 +478,9 @@ command_t *parse_line(const char *line)
 
     command_t *head = NULL;
     command_t *cur = NULL;
+    int replicas = 0;  /* from a preceding |[N], for the next command */
+    int rep_flags = 0;
+    size_t rep_chunk = 0;
 
     int i = 0;
     while (i < toks.count)
@@ -186,6 +497,10 @@ command_t *parse_line(const char *line)
             }
             cur->argv = NULL;
             cur->next = NULL;
+            cur->replicas = replicas;
+            cur->rep_flags = rep_flags;
+            cur->rep_chunk = rep_chunk;
+            replicas = 0;
 
             if (!head)
                 head = cur;
@@ -214,6 +529,27 @@ command_t *parse_line(const char *line)
             continue;
         }
 
+        /* PIPE into a replicated stage */
+        if (toks.kinds[i] == TOK_REPLICATE)
+        {
+            if (!cur->argv)
+            {
+                fprintf(stderr, "osh: syntax error near unexpected token '%s'\n", tok);
+                free_command_chain(head);
+                tokens_free(&toks);
+                return NULL;
+            }
+            if (parse_replicate(tok, &replicas, &rep_flags, &rep_chunk) < 0)
+            {
+                free_command_chain(head);
+                tokens_free(&toks);
+                return NULL;
+            }
+            cur = NULL;
+            i++;
+            continue;
+        }
+
         /* REDIRECTION */
         if (strcmp(tok, "<") == 0)
         {
@@ -224,6 +560,13 @@ command_t *parse_line(const char *line)
                 return NULL;
             }
             cur->infile = strdup_safe(toks.items[i + 1]);
+            if (toks.kinds[i + 1] == TOK_PROCSUB &&
+                add_procsub(cur, toks.items[i + 1], PROCSUB_INFILE) < 0)
+            {
+                free_command_chain(head);
+                tokens_free(&toks);
+                return NULL;
+            }
             i += 2;
             continue;
         }
@@ -239,6 +582,13 @@ command_t *parse_line(const char *line)
             }
             cur->outfile = strdup_safe(toks.items[i + 1]);
             cur->append = append;
+            if (toks.kinds[i + 1] == TOK_PROCSUB &&
+                add_procsub(cur, toks.items[i + 1], PROCSUB_OUTFILE) < 0)
+            {
+                free_command_chain(head);
+                tokens_free(&toks);
+                return NULL;
+            }
             i += 2;
             continue;
         }
@@ -260,14 +610,49 @@ command_t *parse_line(const char *line)
         newargv[argc + 1] = NULL;
         cur->argv = newargv;
 
+        /* the word is replaced by a /dev/fd path when the command runs */
+        if (toks.kinds[i] == TOK_PROCSUB && add_procsub(cur, tok, argc) < 0)
+        {
+            free_command_chain(head);
+            tokens_free(&toks);
+            return NULL;
+        }
+
         i++;
     }
 
     tokens_free(&toks);
 
+    if (replicas)
+    {
+        fprintf(stderr, "osh: missing command after '|[%d]'\n", replicas);
+        free_command_chain(head);
+        return NULL;
+    }
+
+    /* workers would share one substitution's pipe; not supported */
+    for (command_t *c = head; c; c = c->next)
+    {
+        if (c->replicas > 1 && c->subs)
+        {
+            fprintf(stderr, "osh: process substitution in a replicated stage is not supported\n");
+            free_command_chain(head);
+            return NULL;
+        }
+    }
+
     return head;
 }
 
+command_t *parse_line(const char *line)
+{
+    uint64_t t0 = stats_now_ns();
+    command_t *cmd = parse_tokens(line);
+    stats_record(HIST_PARSE, stats_now_ns() - t0);
+    STATS_INC(ST_LINES);
+    return cmd;
+}
+
 /* Free linked command pipeline */
 void free_command_chain(command_t *cmd)
 {
@@ -284,6 +669,13 @@ void free_command_chain(command_t *cmd)
             free(cmd->infile);
         if (cmd->outfile)
             free(cmd->outfile);
+        while (cmd->subs)
+        {
+            procsub_t *ps = cmd->subs;
+            cmd->subs = ps->next;
+            free_command_chain(ps->cmd);
+            free(ps);
+        }
         free(cmd);
         cmd = next;
     }
@@ -0,0 +1,134 @@
+// src/procstat.c
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "procstat.h"
+#include "stats.h"
+
+/* Read a small /proc file into buf. Returns bytes read or -1. */
+static ssize_t read_small(const char *path, char *buf, size_t len)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    ssize_t n = read(fd, buf, len - 1);
+    close(fd);
+    if (n < 0)
+        return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+int proc_sample(pid_t pid, proc_sample_t *out)
+{
+    char path[64];
+    char buf[1024];
+
+    memset(out, 0, sizeof(*out));
+    out->t_ns = stats_now_ns();
+
+    /* stat: "pid (comm) state ppid ... utime(14) stime(15) ..." */
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    if (read_small(path, buf, sizeof(buf)) < 0)
+        return -1;
+    char *lp = strchr(buf, '(');
+    char *rp = strrchr(buf, ')');
+    if (!lp || !rp || rp[1] == '\0')
+        return -1;
+    size_t clen = rp - lp - 1;
+    if (clen >= sizeof(out->comm))
+        clen = sizeof(out->comm) - 1;
+    memcpy(out->comm, lp + 1, clen);
+    out->state = rp[2];
+
+    /* skip to field 14 (utime); rp + 2 is field 3 */
+    char *p = rp + 2;
+    for (int field = 3; field < 14 && p; field++)
+    {
+        p = strchr(p, ' ');
+        if (p)
+            p++;
+    }
+    if (p)
+    {
+        char *end;
+        unsigned long long ut = strtoull(p, &end, 10);
+        unsigned long long st = strtoull(end, NULL, 10);
+        out->ticks = ut + st;
+    }
+
+    /* io: rchar/wchar include pipe traffic, unlike read_bytes */
+    snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+    if (read_small(path, buf, sizeof(buf)) > 0)
+    {
+        char *r = strstr(buf, "rchar:");
+        char *w = strstr(buf, "wchar:");
+        if (r)
+            out->rchar = strtoull(r + 6, NULL, 10);
+        if (w)
+            out->wchar = strtoull(w + 6, NULL, 10);
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/wchan", (int)pid);
+    if (read_small(path, out->wchan, sizeof(out->wchan)) < 0 ||
+        strcmp(out->wchan, "0") == 0)
+        out->wchan[0] = '\0';
+
+    return 0;
+}
+
+/* Format a byte rate as e.g. "12.3M" */
+static void human_rate(double v, char *buf, size_t len)
+{
+    const char *units = " KMGT";
+    int u = 0;
+    while (v >= 1024 && u < 4)
+    {
+        v /= 1024;
+        u++;
+    }
+    if (u == 0)
+        snprintf(buf, len, "%.0f", v);
+    else
+        snprintf(buf, len, "%.1f%c", v, units[u]);
+}
+
+/* What the process is waiting on, from its state and wait channel */
+static const char *blocked_on(const proc_sample_t *s)
+{
+    if (s->state == 'R')
+        return "running";
+    if (s->state == 'T' || s->state == 't')
+        return "stopped";
+    if (s->state == 'Z')
+        return "exited";
+    /* pipe_write, anon_pipe_write, pipe_wait_writable, ... by kernel version */
+    if (strstr(s->wchan, "pipe") && strstr(s->wchan, "writ"))
+        return "write: pipe full";
+    if (strstr(s->wchan, "pipe") && strstr(s->wchan, "read"))
+        return "read: pipe empty";
+    return s->wchan[0] ? s->wchan : "sleeping";
+}
+
+void proc_print_rates(int stage, pid_t pid, const proc_sample_t *prev,
+                      const proc_sample_t *cur)
+{
+    char rd[16] = "-", wr[16] = "-", cpu[16] = "-";
+
+    if (prev && cur->t_ns > prev->t_ns)
+    {
+        double dt = (cur->t_ns - prev->t_ns) / 1e9;
+        long hz = sysconf(_SC_CLK_TCK);
+        human_rate((cur->rchar - prev->rchar) / dt, rd, sizeof(rd));
+        human_rate((cur->wchar - prev->wchar) / dt, wr, sizeof(wr));
+        if (hz > 0)
+            snprintf(cpu, sizeof(cpu), "%.1f",
+                     100.0 * (cur->ticks - prev->ticks) / hz / dt);
+    }
+
+    printf("    %-5d %-7d %-16s %c %9s/s %9s/s %6s%%  %s\n",
+           stage, (int)pid, cur->comm, cur->state, rd, wr, cpu, blocked_on(cur));
+}
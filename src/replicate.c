@@ -0,0 +1,515 @@
+// src/replicate.c
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "replicate.h"
+#include "jobs.h"
+
+#define CHUNK (64 * 1024)                 /* input dealt to an unordered worker at a time; also our read size */
+#define ORDERED_CHUNK (4 * 1024 * 1024) /* input per ordered worker: one exec per chunk */
+
+typedef void (*exec_worker_fn)(command_t *, const char *);
+
+/* Growable byte buffer consumed from the front. Consuming only advances
+ * data; the space before it is reclaimed when an append needs room, so
+ * feeding a large chunk out in pipe-sized writes does not move it each time.
+ */
+typedef struct
+{
+    char *mem;  /* allocation */
+    char *data; /* unconsumed bytes, within mem */
+    size_t len;
+    size_t cap;
+} buf_t;
+
+static void buf_append(buf_t *b, const char *p, size_t n)
+{
+    size_t used = (size_t)(b->data - b->mem);
+    if (used + b->len + n > b->cap && used)
+    {
+        memmove(b->mem, b->data, b->len);
+        b->data = b->mem;
+    }
+    if (b->len + n > b->cap)
+    {
+        size_t ncap = b->cap ? b->cap : CHUNK;
+        while (ncap < b->len + n)
+            ncap *= 2;
+        char *nd = realloc(b->mem, ncap);
+        if (!nd)
+        {
+            perror("realloc");
+            _exit(1);
+        }
+        b->mem = b->data = nd;
+        b->cap = ncap;
+    }
+    memcpy(b->data + b->len, p, n);
+    b->len += n;
+}
+
+static void buf_consume(buf_t *b, size_t n)
+{
+    b->len -= n;
+    b->data = b->len ? b->data + n : b->mem;
+}
+
+static void buf_reset(buf_t *b)
+{
+    b->data = b->mem;
+    b->len = 0;
+}
+
+/* Offset just past the last separator in b, or 0 if there is none */
+static size_t last_record_end(const buf_t *b, int sep)
+{
+    for (size_t i = b->len; i > 0; i--)
+        if (b->data[i - 1] == sep)
+            return i;
+    return 0;
+}
+
+/* Length of the next chunk to deal from in: about chunk bytes of whole
+ * records (everything left at EOF), or 0 if no complete record is buffered.
+ */
+static size_t next_chunk(const buf_t *in, size_t chunk, int sep, int eof)
+{
+    size_t cut = eof ? in->len : last_record_end(in, sep);
+    if (cut <= chunk)
+        return cut;
+    size_t take = chunk;
+    while (take < cut && in->data[take - 1] != sep)
+        take++;
+    return take;
+}
+
+/* Read more input while less than a chunk (or no whole record) is buffered */
+static int want_input(const buf_t *in, size_t chunk, int sep, int eof)
+{
+    return !eof && (in->len < chunk || last_record_end(in, sep) == 0);
+}
+
+static void write_all(int fd, const char *p, size_t n)
+{
+    while (n > 0)
+    {
+        ssize_t w = write(fd, p, n);
+        if (w < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            /* downstream went away: nothing left to do */
+            _exit(errno == EPIPE ? 128 + SIGPIPE : 1);
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+}
+
+/* Fork a worker running c on two new pipes; *in_fd and *out_fd get our
+ * ends (input non-blocking). others are the pipe ends we already hold for
+ * other workers: the child closes them itself, since a builtin worker never
+ * execs and close-on-exec would not apply.
+ */
+static pid_t spawn_worker(command_t *c, const char *path, exec_worker_fn exec_worker,
+                          const int *others, int nothers, int *in_fd, int *out_fd)
+{
+    int ip[2], op[2];
+    if (pipe(ip) < 0)
+    {
+        perror("pipe");
+        _exit(1);
+    }
+    if (pipe(op) < 0)
+    {
+        perror("pipe");
+        _exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        _exit(1);
+    }
+    if (pid == 0)
+    {
+        signal(SIGPIPE, SIG_DFL);
+        dup2(ip[0], STDIN_FILENO);
+        dup2(op[1], STDOUT_FILENO);
+        close(ip[0]);
+        close(ip[1]);
+        close(op[0]);
+        close(op[1]);
+        for (int k = 0; k < nothers; k++)
+            if (others[k] >= 0)
+                close(others[k]);
+        c->replicas = 0;
+        exec_worker(c, path);
+        _exit(127);
+    }
+
+    close(ip[0]);
+    close(op[1]);
+    *in_fd = ip[1];
+    *out_fd = op[0];
+    fcntl(*in_fd, F_SETFL, fcntl(*in_fd, F_GETFL) | O_NONBLOCK);
+    return pid;
+}
+
+/* Write as much of pending as the pipe takes. Returns -1 if the worker
+ * stopped reading (what it would have got is dropped).
+ */
+static int feed(int fd, buf_t *pending)
+{
+    ssize_t r = write(fd, pending->data, pending->len);
+    if (r > 0)
+        buf_consume(pending, (size_t)r);
+    else if (r < 0 && errno != EAGAIN && errno != EINTR)
+    {
+        buf_reset(pending);
+        return -1;
+    }
+    return 0;
+}
+
+/* Read one block from fd into out. Returns 0 at EOF, else 1. */
+static int drain(int fd, buf_t *out, char *rbuf)
+{
+    ssize_t r = read(fd, rbuf, CHUNK);
+    if (r > 0)
+        buf_append(out, rbuf, (size_t)r);
+    return r > 0 || (r < 0 && errno == EINTR);
+}
+
+static void fold_status(pid_t pid, int *code)
+{
+    int status;
+    if (waitpid(pid, &status, 0) > 0 && !*code)
+        *code = status_to_code(status);
+}
+
+/* Unordered: N long-lived workers, each dealt chunks as it goes idle; whole
+ * records are passed on from whichever worker produced them.
+ */
+typedef struct
+{
+    pid_t pid;
+    int in_fd;     /* we write its input here (-1 once closed) */
+    int out_fd;    /* we read its output here (-1 at EOF) */
+    buf_t pending; /* dealt input not yet written */
+    buf_t output;  /* output not yet passed on */
+} worker_t;
+
+static int run_unordered(command_t *c, const char *path, exec_worker_fn exec_worker,
+                         int n, size_t chunk, int sep)
+{
+    worker_t *ws = calloc(n, sizeof(worker_t));
+    int *held = calloc(2 * n, sizeof(int));
+    struct pollfd *pfd = calloc(2 * n + 1, sizeof(struct pollfd));
+    char *rbuf = malloc(CHUNK);
+    if (!ws || !held || !pfd || !rbuf)
+    {
+        perror("malloc");
+        _exit(1);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        ws[i].pid = spawn_worker(c, path, exec_worker, held, 2 * i,
+                                 &ws[i].in_fd, &ws[i].out_fd);
+        held[2 * i] = ws[i].in_fd;
+        held[2 * i + 1] = ws[i].out_fd;
+    }
+
+    buf_t in = {0};
+    int in_eof = 0;
+    int next_w = 0;
+    for (;;)
+    {
+        /* deal whole records to workers with nothing pending */
+        size_t take;
+        while ((take = next_chunk(&in, chunk, sep, in_eof)) > 0)
+        {
+            int w = -1;
+            for (int k = 0; k < n && w < 0; k++)
+            {
+                int cand = (next_w + k) % n;
+                if (ws[cand].in_fd >= 0 && ws[cand].pending.len == 0)
+                    w = cand;
+            }
+            if (w < 0)
+                break;
+            buf_append(&ws[w].pending, in.data, take);
+            buf_consume(&in, take);
+            next_w = (w + 1) % n;
+        }
+
+        /* all input dealt: close worker inputs as they drain */
+        if (in_eof && in.len == 0)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                if (ws[i].in_fd >= 0 && ws[i].pending.len == 0)
+                {
+                    close(ws[i].in_fd);
+                    ws[i].in_fd = -1;
+                }
+            }
+        }
+
+        int np = 0;
+        int stdin_slot = -1;
+        if (want_input(&in, chunk, sep, in_eof))
+        {
+            stdin_slot = np;
+            pfd[np].fd = STDIN_FILENO;
+            pfd[np++].events = POLLIN;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            if (ws[i].in_fd >= 0 && ws[i].pending.len)
+            {
+                pfd[np].fd = ws[i].in_fd;
+                pfd[np++].events = POLLOUT;
+            }
+            if (ws[i].out_fd >= 0)
+            {
+                pfd[np].fd = ws[i].out_fd;
+                pfd[np++].events = POLLIN;
+            }
+        }
+        if (np == 0)
+            break;
+
+        if (poll(pfd, np, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            _exit(1);
+        }
+
+        if (stdin_slot >= 0 && pfd[stdin_slot].revents && !drain(STDIN_FILENO, &in, rbuf))
+            in_eof = 1;
+
+        for (int p = 0; p < np; p++)
+        {
+            if (p == stdin_slot || !pfd[p].revents)
+                continue;
+            for (int i = 0; i < n; i++)
+            {
+                worker_t *w = &ws[i];
+                if (pfd[p].fd == w->in_fd)
+                {
+                    if (feed(w->in_fd, &w->pending) < 0)
+                    {
+                        close(w->in_fd);
+                        w->in_fd = -1;
+                    }
+                    break;
+                }
+                if (pfd[p].fd == w->out_fd)
+                {
+                    if (!drain(w->out_fd, &w->output, rbuf))
+                    {
+                        close(w->out_fd);
+                        w->out_fd = -1;
+                    }
+                    /* pass on whole records; the rest once the worker is done */
+                    size_t cut = w->out_fd < 0 ? w->output.len : last_record_end(&w->output, sep);
+                    write_all(STDOUT_FILENO, w->output.data, cut);
+                    buf_consume(&w->output, cut);
+                    break;
+                }
+            }
+        }
+    }
+
+    int code = 0;
+    for (int i = 0; i < n; i++)
+        fold_status(ws[i].pid, &code);
+    return code;
+}
+
+/* Ordered: every chunk gets a fresh worker (at most N at a time) and its
+ * complete output is released in the order the chunks were dealt, so the
+ * merge does not depend on what the worker prints per record. The oldest
+ * chunk's output streams straight through; later ones are held until it
+ * is done.
+ */
+typedef struct
+{
+    pid_t pid;
+    int in_fd;
+    int out_fd;
+    buf_t pending;
+    buf_t output;
+} chunk_t;
+
+static int run_ordered(command_t *c, const char *path, exec_worker_fn exec_worker,
+                       int n, size_t chunk, int sep)
+{
+    chunk_t *ring = calloc(n, sizeof(chunk_t)); /* live chunks, oldest at head */
+    int *held = calloc(2 * n, sizeof(int));
+    struct pollfd *pfd = calloc(2 * n + 1, sizeof(struct pollfd));
+    char *rbuf = malloc(CHUNK);
+    if (!ring || !held || !pfd || !rbuf)
+    {
+        perror("malloc");
+        _exit(1);
+    }
+
+    buf_t in = {0};
+    int in_eof = 0;
+    int head = 0;
+    int live = 0;
+    int code = 0;
+    for (;;)
+    {
+        /* the head chunk is done: release it and stream the next one's
+         * output (first, so its slot can take the next chunk below)
+         */
+        while (live > 0 && ring[head].out_fd < 0 && ring[head].in_fd < 0)
+        {
+            fold_status(ring[head].pid, &code);
+            head = (head + 1) % n;
+            live--;
+            if (live > 0)
+            {
+                write_all(STDOUT_FILENO, ring[head].output.data, ring[head].output.len);
+                buf_reset(&ring[head].output);
+            }
+        }
+
+        /* start a worker per full chunk while fewer than N are unreleased */
+        size_t take;
+        while (live < n && (in_eof || in.len >= chunk) &&
+               (take = next_chunk(&in, chunk, sep, in_eof)) > 0)
+        {
+            int nh = 0;
+            for (int k = 0; k < live; k++)
+            {
+                chunk_t *o = &ring[(head + k) % n];
+                held[nh++] = o->in_fd;
+                held[nh++] = o->out_fd;
+            }
+            chunk_t *ch = &ring[(head + live) % n];
+            ch->pid = spawn_worker(c, path, exec_worker, held, nh, &ch->in_fd, &ch->out_fd);
+            buf_reset(&ch->pending);
+            buf_reset(&ch->output);
+            buf_append(&ch->pending, in.data, take);
+            buf_consume(&in, take);
+            live++;
+        }
+
+        int np = 0;
+        int stdin_slot = -1;
+        if (live < n && want_input(&in, chunk, sep, in_eof))
+        {
+            stdin_slot = np;
+            pfd[np].fd = STDIN_FILENO;
+            pfd[np++].events = POLLIN;
+        }
+        for (int k = 0; k < live; k++)
+        {
+            chunk_t *ch = &ring[(head + k) % n];
+            if (ch->in_fd >= 0)
+            {
+                pfd[np].fd = ch->in_fd;
+                pfd[np++].events = POLLOUT;
+            }
+            if (ch->out_fd >= 0)
+            {
+                pfd[np].fd = ch->out_fd;
+                pfd[np++].events = POLLIN;
+            }
+        }
+        if (np == 0)
+            break;
+
+        if (poll(pfd, np, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            _exit(1);
+        }
+
+        if (stdin_slot >= 0 && pfd[stdin_slot].revents && !drain(STDIN_FILENO, &in, rbuf))
+            in_eof = 1;
+
+        for (int p = 0; p < np; p++)
+        {
+            if (p == stdin_slot || !pfd[p].revents)
+                continue;
+            for (int k = 0; k < live; k++)
+            {
+                chunk_t *ch = &ring[(head + k) % n];
+                if (pfd[p].fd == ch->in_fd)
+                {
+                    /* a worker sees one chunk: close its input once written */
+                    if (feed(ch->in_fd, &ch->pending) < 0 || ch->pending.len == 0)
+                    {
+                        close(ch->in_fd);
+                        ch->in_fd = -1;
+                    }
+                    break;
+                }
+                if (pfd[p].fd == ch->out_fd)
+                {
+                    if (!drain(ch->out_fd, &ch->output, rbuf))
+                    {
+                        close(ch->out_fd);
+                        ch->out_fd = -1;
+                    }
+                    if (k == 0)
+                    {
+                        write_all(STDOUT_FILENO, ch->output.data, ch->output.len);
+                        buf_reset(&ch->output);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    return code;
+}
+
+void run_replicated(command_t *c, const char *path, exec_worker_fn exec_worker)
+{
+    int sep = (c->rep_flags & REP_NUL) ? '\0' : '\n';
+
+    /* our children: reap them ourselves, and report EPIPE instead of dying */
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int ordered = c->rep_flags & REP_ORDERED;
+    size_t chunk = c->rep_chunk;
+    if (!chunk)
+    {
+        /* ordered chunks each pay for a worker start: keep them big, but
+         * still give every worker a share of a short regular-file input
+         */
+        chunk = ordered ? ORDERED_CHUNK : CHUNK;
+        struct stat st;
+        if (ordered && fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode))
+        {
+            off_t pos = lseek(STDIN_FILENO, 0, SEEK_CUR);
+            size_t share = (size_t)(st.st_size - (pos > 0 ? pos : 0)) / (size_t)c->replicas;
+            if (share < chunk)
+                chunk = share > CHUNK ? share : CHUNK;
+        }
+    }
+
+    if (ordered)
+        _exit(run_ordered(c, path, exec_worker, c->replicas, chunk, sep));
+    _exit(run_unordered(c, path, exec_worker, c->replicas, chunk, sep));
+}
@@ -6,14 +6,26 @@
 #include <signal.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <termios.h>
+#include <time.h>
+#include <poll.h>
+#include <errno.h>
 #include "shell.h"
 #include "jobs.h"
+#include "stats.h"
+#include "history.h"
+
+int last_status = 0;
+
+/* set by the exit builtin; stops the rest of the line and the main loop */
+static int exit_requested = 0;
 
 /* SIGCHLD handler: delegate to jobs subsystem to reap and update states. */
 static void sigchld_handler(int sig)
 {
     (void)sig;
+    STATS_INC(ST_SIGCHLD);
     reap_jobs();
 }
 
@@ -26,186 +38,524 @@ static void sigtstp_ignore(int sig)
     /* intentionally empty: shell itself ignores Ctrl-Z */
 }
 
-/* Helper: trim trailing whitespace and detect/strip a trailing '&' for background */
-static int strip_trailing_ampersand(char *line)
+/* Helper: drop the first n words of a NULL-terminated argv in place */
+static void shift_argv(char **argv, int n)
 {
-    if (!line)
-        return 0;
-    int L = (int)strlen(line);
-    /* trim trailing whitespace */
-    while (L > 0 && (line[L - 1] == ' ' || line[L - 1] == '\t'))
+    int i;
+    for (i = 0; i < n; i++)
+        free(argv[i]);
+    for (i = 0; argv[i + n]; i++)
+        argv[i] = argv[i + n];
+    argv[i] = NULL;
+}
+
+static volatile sig_atomic_t watch_interrupted = 0;
+
+static void watch_sigint(int sig)
+{
+    (void)sig;
+    watch_interrupted = 1;
+}
+
+/* jobs -o [-f] %N: print a job's captured output; -f follows it until the
+ * job closes its output or Ctrl-C is pressed.
+ */
+static int job_output_cmd(const char *spec, int follow)
+{
+    if (!spec || spec[0] != '%')
     {
-        line[--L] = '\0';
+        printf("Usage: jobs -o [-f] %%jobnum\n");
+        return 2;
     }
-    if (L > 0 && line[L - 1] == '&')
+
+    struct sigaction sa, old;
+    sa.sa_handler = watch_sigint;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, &old);
+    watch_interrupted = 0;
+
+    int rc = job_output(atoi(spec + 1), follow, &watch_interrupted);
+
+    sigaction(SIGINT, &old, NULL);
+    if (rc < 0)
+    {
+        printf("No captured output for job %s\n", spec);
+        return 1;
+    }
+    return 0;
+}
+
+/* jobs [-l] [-v [-w secs]] | jobs -o [-f] %N: -w repeats the -v view every
+ * secs seconds until no job is running or Ctrl-C is pressed.
+ */
+static int builtin_jobs(char **argv)
+{
+    int flags = 0;
+    double interval = 0;
+    int output = 0;
+    int follow = 0;
+    const char *spec = NULL;
+
+    for (int i = 1; argv[i]; i++)
     {
-        line[L - 1] = '\0';
-        /* trim whitespace again in case there was space before & */
-        while (L > 0 && (line[L - 1] == ' ' || line[L - 1] == '\t'))
+        if (strcmp(argv[i], "-l") == 0)
+            flags |= JOBS_LONG;
+        else if (strcmp(argv[i], "-v") == 0)
+            flags |= JOBS_IO;
+        else if (strcmp(argv[i], "-w") == 0 && argv[i + 1])
+            interval = atof(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0)
+            output = 1;
+        else if (strcmp(argv[i], "-f") == 0)
+            follow = 1;
+        else if (argv[i][0] == '%' && !spec)
+            spec = argv[i];
+        else
         {
-            line[--L] = '\0';
+            printf("Usage: jobs [-l] [-v [-w secs]] | jobs -o [-f] %%jobnum\n");
+            return 2;
         }
+    }
+
+    if (output)
+        return job_output_cmd(spec, follow);
+
+#ifndef __linux__
+    if (flags & JOBS_IO)
+    {
+        fprintf(stderr, "jobs: -v needs /proc (Linux only)\n");
         return 1;
     }
+#endif
+
+    if (interval <= 0)
+    {
+        list_jobs(flags);
+        return 0;
+    }
+
+    /* shell ignores SIGINT; catch it while watching so Ctrl-C ends the loop */
+    struct sigaction sa, old;
+    sa.sa_handler = watch_sigint;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, &old);
+    watch_interrupted = 0;
+
+    while (!watch_interrupted)
+    {
+        list_jobs(flags | JOBS_IO);
+        if (!jobs_running())
+            break;
+
+        jobs_sleep(interval, &watch_interrupted);
+        printf("\n");
+    }
+
+    sigaction(SIGINT, &old, NULL);
     return 0;
 }
 
-int main(void)
+/* capture [on [SIZE] | off]: send background jobs' stdout/stderr to a
+ * per-job ring of SIZE bytes (default 1M) instead of the terminal.
+ */
+static int builtin_capture(char **argv)
 {
-    char *line = NULL;
-    size_t cap = 0;
-    ssize_t len;
+    if (!argv[1])
+    {
+        size_t sz = jobs_capture_size();
+        if (sz)
+            printf("capture on %zuK\n", sz / 1024);
+        else
+            printf("capture off\n");
+        return 0;
+    }
+    if (strcmp(argv[1], "off") == 0 && !argv[2])
+    {
+        jobs_set_capture(0);
+        return 0;
+    }
 
-    /* Initialize jobs subsystem and install SIGCHLD handler */
-    jobs_init();
-    struct sigaction sa;
-    sa.sa_handler = sigchld_handler;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = SA_RESTART;
-    sigaction(SIGCHLD, &sa, NULL);
+    rlim_t sz = 1024 * 1024;
+    if (strcmp(argv[1], "on") != 0 || (argv[2] && (argv[3] || parse_size(argv[2], &sz) < 0)))
+    {
+        printf("Usage: capture [on [SIZE] | off]\n");
+        return 2;
+    }
+    if (sz < 4096)
+    {
+        fprintf(stderr, "capture: size must be at least 4K\n");
+        return 1;
+    }
+#ifndef __linux__
+    fprintf(stderr, "capture: not supported on this platform\n");
+    return 1;
+#endif
+    jobs_set_capture((size_t)sz);
+    return 0;
+}
 
-    /* Shell ignores Ctrl-C and Ctrl-Z; children will reset to defaults. */
-    signal(SIGINT, SIG_IGN);         // shell ignores Ctrl-C
-    signal(SIGTSTP, sigtstp_ignore); // shell ignores Ctrl-Z
-    signal(SIGTTOU, SIG_IGN);
+/* Parse and run one pipeline of a command list, including builtins.
+ * Returns its exit status.
+ */
+static int run_pipeline(const char *text, int background)
+{
+    /* parse the text into a pipeline of command_t */
+    command_t *cmd = parse_line(text);
+    if (!cmd)
+        return 2; /* parse error (split_list never passes an empty pipeline) */
 
-    while (1)
+    /* prefixes, in any order, strip their options and apply to the job:
+     *   limit [--cpus L] [--nice N] [--mem S] [--nofile N] cmd ...
+     *   timeout [-s SIG] [-k grace] duration cmd ...
+     */
+    job_limits_t limits;
+    job_timeout_t tmo;
+    int has_limits = 0;
+    int has_timeout = 0;
+    while (cmd->argv && cmd->argv[0])
     {
-        printf("osh> ");
-        fflush(stdout);
+        int skip;
+        if (strcmp(cmd->argv[0], "limit") == 0)
+        {
+            skip = parse_limits(cmd->argv, &limits);
+            has_limits = 1;
+        }
+        else if (strcmp(cmd->argv[0], "timeout") == 0)
+        {
+            skip = parse_timeout(cmd->argv, &tmo);
+            has_timeout = tmo.ms > 0; /* timeout 0: no limit */
+        }
+        else
+            break;
 
-        len = getline(&line, &cap, stdin);
-        if (len == -1)
+        if (skip < 0)
+        {
+            free_command_chain(cmd);
+            return 2;
+        }
+        shift_argv(cmd->argv, skip);
+    }
+
+    /* quick access to first command's argv for builtins */
+    char **argv = cmd->argv;
+    int rc = 0;
+
+    if (argv && argv[0] && !has_limits && !has_timeout)
+    {
+        /* built-in: exit [N] */
+        if (strcmp(argv[0], "exit") == 0)
         {
-            if (feof(stdin))
+            rc = argv[1] ? atoi(argv[1]) & 0xff : last_status;
+            exit_requested = 1;
+            free_command_chain(cmd);
+            return rc;
+        }
+
+        /* built-in: cd */
+        if (strcmp(argv[0], "cd") == 0)
+        {
+            if (argv[1])
             {
-                /* Ctrl-D / EOF */
-                printf("\n");
-                break;
+                if (chdir(argv[1]) != 0)
+                {
+                    perror("cd");
+                    rc = 1;
+                }
             }
-            perror("getline");
-            continue;
+            else
+            {
+                char *home = getenv("HOME");
+                if (home && chdir(home) != 0)
+                    rc = 1;
+            }
+            free_command_chain(cmd);
+            return rc;
         }
 
-        /* remove trailing newline */
-        if (len > 0 && line[len - 1] == '\n')
-            line[len - 1] = '\0';
+        /* built-in: jobs [-l] [-v [-w secs]] | jobs -o [-f] %N */
+        if (strcmp(argv[0], "jobs") == 0)
+        {
+            rc = builtin_jobs(argv);
+            free_command_chain(cmd);
+            return rc;
+        }
 
-        /* detect background operator (&) at end and strip it */
-        int background = strip_trailing_ampersand(line);
+        /* built-in: capture [on [SIZE] | off] */
+        if (strcmp(argv[0], "capture") == 0)
+        {
+            rc = builtin_capture(argv);
+            free_command_chain(cmd);
+            return rc;
+        }
 
-        /* parse the line into a pipeline of command_t */
-        command_t *cmd = parse_line(line);
-        if (!cmd)
-            continue; /* empty line or parse error */
+        /* built-in: history [N] | history -g STR */
+        if (strcmp(argv[0], "history") == 0)
+        {
+            if (argv[1] && strcmp(argv[1], "-g") == 0 && argv[2])
+                history_grep(stdout, argv[2]);
+            else if (!argv[1] || (argv[1][0] != '-' && !argv[2]))
+                history_print(stdout, argv[1] ? strtoul(argv[1], NULL, 10) : 0);
+            else
+            {
+                printf("Usage: history [N] | history -g STR\n");
+                rc = 2;
+            }
+            free_command_chain(cmd);
+            return rc;
+        }
 
-        /* quick access to first command's argv for builtins */
-        char **argv = cmd->argv;
+        /* built-in: stats [--json] */
+        if (strcmp(argv[0], "stats") == 0)
+        {
+            stats_print(stdout, argv[1] && strcmp(argv[1], "--json") == 0);
+            free_command_chain(cmd);
+            return 0;
+        }
 
-        if (argv && argv[0])
+        /* built-in: fg %N */
+        if (strcmp(argv[0], "fg") == 0)
         {
-            /* built-in: exit */
-            if (strcmp(argv[0], "exit") == 0)
+            if (!argv[1] || argv[1][0] != '%')
             {
-                free_command_chain(cmd);
-                break;
+                printf("Usage: fg %%jobnum\n");
+                rc = 2;
             }
-
-            /* built-in: cd */
-            if (strcmp(argv[0], "cd") == 0)
+            else
             {
-                if (argv[1])
+                int jobnum = atoi(argv[1] + 1);
+                pid_t pgid = get_job_pgid(jobnum);
+                if (pgid < 0)
                 {
-                    if (chdir(argv[1]) != 0)
-                        perror("cd");
+                    printf("No such job\n");
+                    rc = 1;
                 }
                 else
                 {
-                    char *home = getenv("HOME");
-                    if (home)
-                        chdir(home);
+                    /* hold SIGCHLD so wait_job() sees every member's status */
+                    sigset_t chld, oldmask;
+                    sigemptyset(&chld);
+                    sigaddset(&chld, SIGCHLD);
+                    sigprocmask(SIG_BLOCK, &chld, &oldmask);
+
+                    /* give terminal to job and continue it */
+                    uint64_t t0 = stats_now_ns();
+                    tcsetpgrp(STDIN_FILENO, pgid);
+                    kill(-pgid, SIGCONT);
+                    set_job_state(pgid, JOB_RUNNING);
+                    /* wait until it finishes (job removed) or stops again */
+                    rc = wait_job(pgid);
+                    /* restore terminal to shell */
+                    tcsetpgrp(STDIN_FILENO, getpgrp());
+                    stats_record(HIST_FG_WAIT, stats_now_ns() - t0);
+
+                    reap_jobs();
+                    sigprocmask(SIG_SETMASK, &oldmask, NULL);
                 }
-                free_command_chain(cmd);
-                continue;
             }
+            free_command_chain(cmd);
+            return rc;
+        }
 
-            /* built-in: jobs */
-            if (strcmp(argv[0], "jobs") == 0)
+        /* built-in: bg %N */
+        if (strcmp(argv[0], "bg") == 0)
+        {
+            if (!argv[1] || argv[1][0] != '%')
             {
-                list_jobs();
-                free_command_chain(cmd);
-                continue;
+                printf("Usage: bg %%jobnum\n");
+                rc = 2;
             }
-
-            /* built-in: fg %N */
-            if (strcmp(argv[0], "fg") == 0)
+            else
             {
-                if (!argv[1] || argv[1][0] != '%')
+                int jobnum = atoi(argv[1] + 1);
+                pid_t pgid = get_job_pgid(jobnum);
+                if (pgid < 0)
                 {
-                    printf("Usage: fg %%jobnum\n");
+                    printf("No such job\n");
+                    rc = 1;
                 }
                 else
                 {
-                    int jobnum = atoi(argv[1] + 1);
-                    pid_t pgid = get_job_pgid(jobnum);
-                    if (pgid < 0)
-                    {
-                        printf("No such job\n");
-                    }
-                    else
-                    {
-                        /* give terminal to job and continue it */
-                        tcsetpgrp(STDIN_FILENO, pgid);
-                        kill(-pgid, SIGCONT);
-                        /* wait for any process in the group */
-                        int status;
-                        waitpid(-pgid, &status, WUNTRACED);
-                        /* restore terminal to shell */
-                        tcsetpgrp(STDIN_FILENO, getpgrp());
-                        /* if stopped, job handler (reap_jobs) or code below will add it */
-                    }
+                    kill(-pgid, SIGCONT);
+                    set_job_state(pgid, JOB_RUNNING);
                 }
-                free_command_chain(cmd);
-                continue;
             }
+            free_command_chain(cmd);
+            return rc;
+        }
+    }
+
+    /* otherwise execute the pipeline (execute_pipeline handles background & job registration) */
+    rc = execute_pipeline(cmd, background, text, has_limits ? &limits : NULL,
+                          has_timeout ? &tmo : NULL);
+    if (rc < 0)
+    {
+        fprintf(stderr, "osh: failed to execute command\n");
+        rc = 1;
+    }
+
+    free_command_chain(cmd);
+    return rc;
+}
+
+/* Line input. stdin is read through our own buffer rather than stdio so we
+ * know when a complete line is already buffered; otherwise we sleep in
+ * poll() on stdin, the timeout wheel and captured job output together.
+ */
+static char inbuf[4096];
+static size_t in_pos, in_len;
+static int in_eof;
+
+/* Block until stdin is readable, firing due timeouts and draining
+ * captured job output meanwhile
+ */
+static void wait_for_input(void)
+{
+    while (jobs_need_poll())
+    {
+        if (jobs_poll(STDIN_FILENO, -1) != 0)
+            return;
+    }
+}
+
+/* getline() replacement. Returns the line length (including any '\n'),
+ * or -1 at end of input.
+ */
+static ssize_t read_line(char **line, size_t *cap)
+{
+    size_t len = 0;
 
-            /* built-in: bg %N */
-            if (strcmp(argv[0], "bg") == 0)
+    for (;;)
+    {
+        while (in_pos < in_len)
+        {
+            if (len + 2 > *cap)
             {
-                if (!argv[1] || argv[1][0] != '%')
-                {
-                    printf("Usage: bg %%jobnum\n");
-                }
-                else
+                size_t ncap = *cap ? *cap * 2 : 128;
+                char *n = realloc(*line, ncap);
+                if (!n)
                 {
-                    int jobnum = atoi(argv[1] + 1);
-                    pid_t pgid = get_job_pgid(jobnum);
-                    if (pgid < 0)
-                    {
-                        printf("No such job\n");
-                    }
-                    else
-                    {
-                        kill(-pgid, SIGCONT);
-                        set_job_state(pgid, JOB_RUNNING);
-                    }
+                    perror("realloc");
+                    return -1;
                 }
-                free_command_chain(cmd);
-                continue;
+                *line = n;
+                *cap = ncap;
+            }
+            char c = inbuf[in_pos++];
+            (*line)[len++] = c;
+            if (c == '\n')
+            {
+                (*line)[len] = '\0';
+                return (ssize_t)len;
             }
         }
+        if (in_eof)
+            break;
 
-        /* otherwise execute the pipeline (execute_pipeline handles background & job registration) */
-        int rc = execute_pipeline(cmd, background, line);
-        if (rc < 0)
+        wait_for_input();
+        ssize_t n = read(STDIN_FILENO, inbuf, sizeof(inbuf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            perror("read");
+        if (n <= 0)
         {
-            fprintf(stderr, "osh: failed to execute command\n");
+            in_eof = 1;
+            break;
         }
+        in_pos = 0;
+        in_len = (size_t)n;
+    }
+
+    if (len == 0)
+        return -1;
+    (*line)[len] = '\0';
+    return (ssize_t)len;
+}
 
-        free_command_chain(cmd);
+int main(void)
+{
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+
+    /* Initialize jobs subsystem and install SIGCHLD handler */
+    jobs_init();
+    timer_init(); /* timeout builtin is unavailable if this fails */
+    history_init();
+    struct sigaction sa;
+    sa.sa_handler = sigchld_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGCHLD, &sa, NULL);
+
+    /* Shell ignores Ctrl-C and Ctrl-Z; children will reset to defaults. */
+    signal(SIGINT, SIG_IGN);         // shell ignores Ctrl-C
+    signal(SIGTSTP, sigtstp_ignore); // shell ignores Ctrl-Z
+    signal(SIGTTOU, SIG_IGN);
+
+    while (!exit_requested)
+    {
+        printf("osh> ");
+        fflush(stdout);
+
+        len = read_line(&line, &cap);
+        if (len == -1)
+        {
+            /* Ctrl-D / EOF */
+            printf("\n");
+            break;
+        }
+
+        /* remove trailing newline */
+        if (len > 0 && line[len - 1] == '\n')
+            line[len - 1] = '\0';
+
+        /* !!, !N, !-N, !prefix */
+        char *expanded = NULL;
+        int hx = history_expand(line, &expanded);
+        if (hx < 0)
+        {
+            last_status = 1;
+            continue;
+        }
+        if (hx)
+        {
+            free(line);
+            line = expanded;
+            cap = strlen(line) + 1;
+            printf("%s\n", line);
+            fflush(stdout);
+        }
+        history_add(line);
+
+        /* split into pipelines joined by ; & && || */
+        cmdlist_t *list = split_list(line);
+        if (!list)
+        {
+            /* a blank line keeps $?; anything else was a syntax error */
+            if (line[strspn(line, " \t\r\v\f")])
+                last_status = 2;
+            continue;
+        }
+
+        for (cmdlist_t *e = list; e && !exit_requested; e = e->next)
+        {
+            /* short-circuit: skipped entries keep the previous status */
+            if (e->op == LIST_AND && last_status != 0)
+                continue;
+            if (e->op == LIST_OR && last_status == 0)
+                continue;
+            last_status = run_pipeline(e->text, e->background);
+        }
+
+        free_cmdlist(list);
     } /* end while */
 
     free(line);
+    history_shutdown();
     jobs_shutdown();
-    return 0;
+    stats_dump_at_exit();
+    return last_status;
 }
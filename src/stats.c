@@ -0,0 +1,147 @@
+// src/stats.c
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+#define HIST_BUCKETS 32 /* bucket i holds samples < 2^i us; last is open-ended */
+
+typedef struct
+{
+    unsigned long count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    unsigned long buckets[HIST_BUCKETS];
+} hist_t;
+
+volatile unsigned long stats_counters[ST_COUNT];
+static hist_t hists[HIST_COUNT];
+
+static const char *counter_names[ST_COUNT] = {
+    "lines_parsed",
+    "forks",
+    "exec_failures",
+    "path_hits",
+    "path_misses",
+    "sigchld",
+    "reaps",
+};
+
+static const char *hist_names[HIST_COUNT] = {
+    "parse_time",
+    "fg_wait_time",
+};
+
+uint64_t stats_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void stats_record(stats_hist_t h, uint64_t ns)
+{
+    hist_t *hp = &hists[h];
+    uint64_t us = ns / 1000;
+    int b = 0;
+    while (b < HIST_BUCKETS - 1 && us >= (1ull << b))
+        b++;
+
+    hp->count++;
+    hp->total_ns += ns;
+    if (ns > hp->max_ns)
+        hp->max_ns = ns;
+    hp->buckets[b]++;
+}
+
+/* Upper bound (us) of the bucket holding the q-th quantile */
+static uint64_t hist_quantile(const hist_t *hp, double q)
+{
+    unsigned long want = (unsigned long)(q * hp->count);
+    unsigned long seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++)
+    {
+        seen += hp->buckets[b];
+        if (seen > want)
+            return 1ull << b;
+    }
+    return 1ull << (HIST_BUCKETS - 1);
+}
+
+static void print_human(FILE *f)
+{
+    for (int i = 0; i < ST_COUNT; i++)
+        fprintf(f, "%-16s %lu\n", counter_names[i], stats_counters[i]);
+
+    for (int h = 0; h < HIST_COUNT; h++)
+    {
+        const hist_t *hp = &hists[h];
+        if (!hp->count)
+        {
+            fprintf(f, "%-16s no samples\n", hist_names[h]);
+            continue;
+        }
+        fprintf(f, "%-16s n=%lu avg=%.1fus max=%.1fus p50<%lluus p90<%lluus p99<%lluus\n",
+                hist_names[h], hp->count,
+                hp->total_ns / 1000.0 / hp->count, hp->max_ns / 1000.0,
+                (unsigned long long)hist_quantile(hp, 0.50),
+                (unsigned long long)hist_quantile(hp, 0.90),
+                (unsigned long long)hist_quantile(hp, 0.99));
+    }
+}
+
+static void print_json(FILE *f)
+{
+    fprintf(f, "{");
+    for (int i = 0; i < ST_COUNT; i++)
+        fprintf(f, "\"%s\":%lu,", counter_names[i], stats_counters[i]);
+
+    for (int h = 0; h < HIST_COUNT; h++)
+    {
+        const hist_t *hp = &hists[h];
+        fprintf(f, "\"%s\":{\"count\":%lu,\"total_ns\":%llu,\"max_ns\":%llu,\"buckets_us\":[",
+                hist_names[h], hp->count,
+                (unsigned long long)hp->total_ns, (unsigned long long)hp->max_ns);
+        /* trailing empty buckets are omitted */
+        int last = HIST_BUCKETS - 1;
+        while (last >= 0 && !hp->buckets[last])
+            last--;
+        for (int b = 0; b <= last; b++)
+            fprintf(f, "%s%lu", b ? "," : "", hp->buckets[b]);
+        fprintf(f, "]}%s", h < HIST_COUNT - 1 ? "," : "");
+    }
+    fprintf(f, "}\n");
+}
+
+void stats_print(FILE *f, int json)
+{
+    if (json)
+        print_json(f);
+    else
+        print_human(f);
+    fflush(f);
+}
+
+void stats_dump_at_exit(void)
+{
+    const char *path = getenv("OSH_STATS_FILE");
+    if (!path || !*path)
+        return;
+
+    if (strcmp(path, "-") == 0)
+    {
+        stats_print(stderr, 1);
+        return;
+    }
+
+    FILE *f = fopen(path, "a");
+    if (!f)
+    {
+        perror("stats");
+        return;
+    }
+    stats_print(f, 1);
+    fclose(f);
+}
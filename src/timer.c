@@ -0,0 +1,393 @@
+// src/timer.c
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
+#include "timer.h"
+#include "stats.h"
+
+/* Hashed timer wheel: one timerfd for every timed job. A timeout lives in
+ * slot (expiry tick % WHEEL_SLOTS); entries more than one revolution away
+ * stay in their slot until their tick comes round.
+ */
+#define TICK_MS 10
+#define WHEEL_SLOTS 512
+
+typedef struct timeout
+{
+    pid_t pgid;
+    int sig;
+    uint64_t kill_after_ms;
+    uint64_t expires;      /* absolute tick */
+    int on_wheel;          /* 1 while linked into a slot */
+    int fired;             /* 1 once sig was sent */
+    int killed;            /* 1 once the group was sent SIGKILL */
+    struct timeout *next;  /* slot chain */
+    struct timeout *all;   /* list of every record */
+} timeout_t;
+
+static int tfd = -1;
+static uint64_t start_ns;
+static uint64_t cur_tick; /* last tick processed */
+static int armed;         /* entries on the wheel */
+static timeout_t *slots[WHEEL_SLOTS];
+static timeout_t *all_head;
+
+/* The SIGCHLD handler may disarm timeouts; keep it out while we edit */
+static void block_chld(sigset_t *old)
+{
+    sigset_t s;
+    sigemptyset(&s);
+    sigaddset(&s, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &s, old);
+}
+
+static void unblock_chld(const sigset_t *old)
+{
+    sigprocmask(SIG_SETMASK, old, NULL);
+}
+
+static uint64_t now_tick(void)
+{
+    return (stats_now_ns() - start_ns) / (TICK_MS * 1000000ull);
+}
+
+static void wheel_insert(timeout_t *t)
+{
+    timeout_t **slot = &slots[t->expires % WHEEL_SLOTS];
+    t->next = *slot;
+    *slot = t;
+    t->on_wheel = 1;
+    armed++;
+}
+
+static void wheel_remove(timeout_t *t)
+{
+    if (!t->on_wheel)
+        return;
+    for (timeout_t **pp = &slots[t->expires % WHEEL_SLOTS]; *pp; pp = &(*pp)->next)
+    {
+        if (*pp == t)
+        {
+            *pp = t->next;
+            break;
+        }
+    }
+    t->on_wheel = 0;
+    armed--;
+}
+
+/* Point the timerfd at the next tick that has a due entry */
+static void rearm(void)
+{
+#ifdef __linux__
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+
+    if (armed)
+    {
+        uint64_t next = cur_tick + WHEEL_SLOTS; /* look again in one revolution */
+        for (uint64_t k = 1; k <= WHEEL_SLOTS; k++)
+        {
+            uint64_t tick = cur_tick + k;
+            timeout_t *t = slots[tick % WHEEL_SLOTS];
+            for (; t && t->expires > tick; t = t->next)
+                ;
+            if (t)
+            {
+                next = tick;
+                break;
+            }
+        }
+        uint64_t ns = start_ns + next * TICK_MS * 1000000ull;
+        its.it_value.tv_sec = ns / 1000000000ull;
+        its.it_value.tv_nsec = ns % 1000000000ull;
+    }
+    timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+#endif
+}
+
+int timer_init(void)
+{
+#ifdef __linux__
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd < 0)
+        return -1;
+    start_ns = stats_now_ns();
+    cur_tick = 0;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int timer_fd(void)
+{
+    return tfd;
+}
+
+int timer_pending(void)
+{
+    return armed;
+}
+
+static timeout_t *find(pid_t pgid)
+{
+    for (timeout_t *t = all_head; t; t = t->all)
+        if (t->pgid == pgid)
+            return t;
+    return NULL;
+}
+
+/* Signal the group; a grace period re-queues it for SIGKILL */
+static void fire(timeout_t *t, uint64_t now)
+{
+    if (!t->fired)
+    {
+        t->fired = 1;
+        t->killed = t->sig == SIGKILL;
+        kill(-t->pgid, t->sig);
+        kill(-t->pgid, SIGCONT); /* a stopped job must see the signal */
+        if (t->kill_after_ms)
+        {
+            t->expires = now + (t->kill_after_ms + TICK_MS - 1) / TICK_MS;
+            wheel_insert(t);
+        }
+    }
+    else
+    {
+        t->killed = 1;
+        kill(-t->pgid, SIGKILL);
+    }
+}
+
+void timer_service(void)
+{
+    if (tfd < 0)
+        return;
+
+    sigset_t old;
+    block_chld(&old);
+
+    uint64_t expirations;
+    while (read(tfd, &expirations, sizeof(expirations)) > 0)
+        ;
+
+    uint64_t now = now_tick();
+    uint64_t span = now - cur_tick;
+    if (span > WHEEL_SLOTS)
+        span = WHEEL_SLOTS;
+
+    /* walk the slots of every tick since the last service */
+    for (uint64_t k = 1; k <= span; k++)
+    {
+        timeout_t **pp = &slots[(cur_tick + k) % WHEEL_SLOTS];
+        while (*pp)
+        {
+            timeout_t *t = *pp;
+            if (t->expires > now)
+            {
+                pp = &t->next;
+                continue;
+            }
+            *pp = t->next;
+            t->on_wheel = 0;
+            armed--;
+            fire(t, now);
+        }
+    }
+    cur_tick = now;
+    rearm();
+
+    unblock_chld(&old);
+}
+
+int timeout_arm(pid_t pgid, const job_timeout_t *spec)
+{
+    if (tfd < 0)
+        return -1;
+
+    timeout_t *t = calloc(1, sizeof(timeout_t));
+    if (!t)
+        return -1;
+    t->pgid = pgid;
+    t->sig = spec->sig;
+    t->kill_after_ms = spec->kill_after_ms;
+
+    sigset_t old;
+    block_chld(&old);
+
+    /* catch up first so cur_tick is current */
+    if (!armed)
+        cur_tick = now_tick();
+    uint64_t ticks = (spec->ms + TICK_MS - 1) / TICK_MS;
+    t->expires = now_tick() + (ticks ? ticks : 1);
+    if (t->expires <= cur_tick)
+        t->expires = cur_tick + 1;
+
+    t->all = all_head;
+    all_head = t;
+    wheel_insert(t);
+    rearm();
+
+    unblock_chld(&old);
+    return 0;
+}
+
+void timeout_disarm(pid_t pgid)
+{
+    /* called from the SIGCHLD handler: no locking, no allocation */
+    timeout_t *t = find(pgid);
+    if (t && t->on_wheel)
+    {
+        wheel_remove(t);
+        rearm();
+    }
+}
+
+void timeout_forget(pid_t pgid)
+{
+    sigset_t old;
+    block_chld(&old);
+
+    for (timeout_t **pp = &all_head; *pp; pp = &(*pp)->all)
+    {
+        if ((*pp)->pgid == pgid)
+        {
+            timeout_t *t = *pp;
+            wheel_remove(t);
+            *pp = t->all;
+            free(t);
+            rearm();
+            break;
+        }
+    }
+
+    unblock_chld(&old);
+}
+
+int timeout_expired(pid_t pgid)
+{
+    timeout_t *t = find(pgid);
+    if (!t || !t->fired)
+        return 0;
+    return t->killed ? 128 + SIGKILL : TIMEOUT_STATUS;
+}
+
+/* Duration like "10", "1.5s", "2m", "1h", "1d" in milliseconds */
+static int parse_duration(const char *s, uint64_t *ms)
+{
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s || v < 0)
+        return -1;
+    double mult = 1000;
+    if (*end)
+    {
+        switch (*end)
+        {
+        case 's':
+            break;
+        case 'm':
+            mult *= 60;
+            break;
+        case 'h':
+            mult *= 3600;
+            break;
+        case 'd':
+            mult *= 86400;
+            break;
+        default:
+            return -1;
+        }
+        if (end[1])
+            return -1;
+    }
+    /* strtod() takes "inf", "nan" and 1e300; the cast needs a finite fit */
+    double total = v * mult;
+    if (!isfinite(total) || total > (double)(UINT64_MAX / 1000))
+        return -1;
+    *ms = (uint64_t)total;
+    if (v > 0 && *ms == 0)
+        *ms = 1; /* only 0 itself means "never" */
+    return 0;
+}
+
+static const struct
+{
+    const char *name;
+    int sig;
+} signames[] = {
+    {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+    {"USR1", SIGUSR1}, {"USR2", SIGUSR2}, {"ALRM", SIGALRM}, {"TERM", SIGTERM},
+};
+
+static int parse_signal(const char *s)
+{
+    char *end;
+    long n = strtol(s, &end, 10);
+    if (end != s && !*end)
+        return (n > 0 && n < NSIG) ? (int)n : -1;
+    if (strncasecmp(s, "SIG", 3) == 0)
+        s += 3;
+    for (size_t i = 0; i < sizeof(signames) / sizeof(signames[0]); i++)
+        if (strcasecmp(s, signames[i].name) == 0)
+            return signames[i].sig;
+    return -1;
+}
+
+int parse_timeout(char **argv, job_timeout_t *t)
+{
+    memset(t, 0, sizeof(*t));
+    t->sig = SIGTERM;
+
+    int i = 1;
+    while (argv[i] && argv[i][0] == '-')
+    {
+        if (strcmp(argv[i], "-s") == 0 && argv[i + 1])
+        {
+            t->sig = parse_signal(argv[i + 1]);
+            if (t->sig < 0)
+            {
+                fprintf(stderr, "timeout: bad signal '%s'\n", argv[i + 1]);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "-k") == 0 && argv[i + 1])
+        {
+            if (parse_duration(argv[i + 1], &t->kill_after_ms) < 0)
+            {
+                fprintf(stderr, "timeout: bad duration '%s'\n", argv[i + 1]);
+                return -1;
+            }
+        }
+        else
+            break;
+        i += 2;
+    }
+
+    if (!argv[i] || !argv[i + 1])
+    {
+        fprintf(stderr, "Usage: timeout [-s SIG] [-k grace] duration command\n");
+        return -1;
+    }
+    if (parse_duration(argv[i], &t->ms) < 0)
+    {
+        fprintf(stderr, "timeout: bad duration '%s'\n", argv[i]);
+        return -1;
+    }
+    if (tfd < 0)
+    {
+        fprintf(stderr, "timeout: not supported on this platform\n");
+        return -1;
+    }
+    return i + 1;
+}
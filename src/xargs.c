@@ -0,0 +1,430 @@
+// src/xargs.c
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "xargs.h"
+#include "shell.h"
+#include "jobs.h"
+#include "filecmds.h"
+
+#define READ_CHUNK (256 * 1024) /* bytes of items read from stdin at a time */
+#define ARG_HEADROOM 2048       /* slack POSIX recommends leaving below ARG_MAX */
+
+extern char **environ;
+
+/* Items from stdin: NUL-terminated with -0, otherwise separated by blanks
+ * and newlines with GNU xargs quoting ('...', "..." and backslash).
+ */
+typedef struct
+{
+    int nul;
+    char *buf;
+    size_t pos;
+    size_t len;
+    size_t cap;
+    int eof;
+    int err;       /* unmatched quote */
+    char *scratch; /* unquoted item being built */
+    size_t scap;
+} reader_t;
+
+static int is_blank(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n';
+}
+
+/* Top up the buffer; returns 0, or -1 once there is nothing more to read */
+static int fill(reader_t *r)
+{
+    if (r->eof)
+        return -1;
+
+    /* keep the unconsumed tail, make room for another chunk */
+    memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+    r->len -= r->pos;
+    r->pos = 0;
+    if (r->cap - r->len < READ_CHUNK)
+    {
+        size_t ncap = r->len + READ_CHUNK;
+        char *nb = realloc(r->buf, ncap);
+        if (!nb)
+        {
+            perror("xargs: realloc");
+            r->eof = 1;
+            return -1;
+        }
+        r->buf = nb;
+        r->cap = ncap;
+    }
+
+    ssize_t n;
+    while ((n = read(STDIN_FILENO, r->buf + r->len, r->cap - r->len)) < 0 && errno == EINTR)
+        ;
+    if (n <= 0)
+    {
+        if (n < 0)
+            perror("xargs: read");
+        r->eof = 1;
+        return r->len > 0 ? 0 : -1;
+    }
+    r->len += (size_t)n;
+    return 0;
+}
+
+/* Unquote the item starting at r->pos into out. Returns the offset just
+ * past it, 0 if the buffer ends first (more input needed), or -1 on an
+ * unmatched quote.
+ */
+static long scan_quoted(const reader_t *r, char *out, size_t *olen)
+{
+    char quote = 0;
+    size_t i = r->pos;
+    *olen = 0;
+    while (i < r->len)
+    {
+        char ch = r->buf[i++];
+        if (quote)
+        {
+            if (ch == quote)
+                quote = 0;
+            else if (ch == '\n')
+                return -1;
+            else
+                out[(*olen)++] = ch;
+        }
+        else if (is_blank(ch))
+            return (long)i - 1;
+        else if (ch == '\'' || ch == '"')
+            quote = ch;
+        else if (ch == '\\')
+        {
+            if (i == r->len)
+                break;
+            out[(*olen)++] = r->buf[i++];
+        }
+        else
+            out[(*olen)++] = ch;
+    }
+    if (!r->eof)
+        return 0;
+    return quote ? -1 : (long)i;
+}
+
+/* Next item as a malloc'd string, or NULL at end of input (or error) */
+static char *next_item(reader_t *r)
+{
+    for (;;)
+    {
+        if (r->nul)
+        {
+            while (r->pos < r->len && r->buf[r->pos] == '\0')
+                r->pos++;
+            char *z = memchr(r->buf + r->pos, '\0', r->len - r->pos);
+            size_t end = z ? (size_t)(z - r->buf) : r->len;
+            if (end > r->pos && (z || r->eof))
+            {
+                char *item = strndup(r->buf + r->pos, end - r->pos);
+                r->pos = end;
+                return item;
+            }
+        }
+        else
+        {
+            while (r->pos < r->len && is_blank(r->buf[r->pos]))
+                r->pos++;
+            if (r->pos < r->len)
+            {
+                /* an unquoted item is never longer than its source text */
+                if (r->scap < r->len - r->pos)
+                {
+                    r->scap = r->len - r->pos;
+                    free(r->scratch);
+                    r->scratch = malloc(r->scap);
+                    if (!r->scratch)
+                    {
+                        perror("xargs: malloc");
+                        _exit(1);
+                    }
+                }
+                size_t ilen;
+                long end = scan_quoted(r, r->scratch, &ilen);
+                if (end > 0)
+                {
+                    r->pos = (size_t)end;
+                    return strndup(r->scratch, ilen);
+                }
+                if (end < 0)
+                {
+                    fprintf(stderr, "xargs: unmatched quote\n");
+                    r->err = 1;
+                    return NULL;
+                }
+            }
+        }
+        if (fill(r) < 0)
+            return NULL;
+    }
+}
+
+/* Bytes the environment takes out of ARG_MAX */
+static size_t env_size(void)
+{
+    size_t n = 0;
+    for (char **e = environ; e && *e; e++)
+        n += strlen(*e) + 1 + sizeof(char *);
+    return n;
+}
+
+/* Fold one batch's wait status into rc (worst wins: 123 < 124 < ... < 127).
+ * Returns 1 if no further batches should be started.
+ */
+static int account(int status, int *rc)
+{
+    int code = status_to_code(status);
+    int mapped = 0;
+    if (WIFSIGNALED(status))
+        mapped = 125;
+    else if (code == 255)
+        mapped = 124;
+    else if (code == 126 || code == 127)
+        mapped = code;
+    else if (code)
+        mapped = 123;
+    if (mapped > *rc)
+        *rc = mapped;
+    return mapped > 123;
+}
+
+/* Wait for one of the *running batches in pids. Other children (process
+ * substitution helpers) are reaped and ignored. Returns 1 if no further
+ * batches should be started.
+ */
+static int reap_batch(pid_t *pids, int *running, int *rc)
+{
+    for (;;)
+    {
+        int status;
+        pid_t p = waitpid(-1, &status, 0);
+        if (p < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            *running = 0;
+            return 0;
+        }
+        for (int k = 0; k < *running; k++)
+        {
+            if (pids[k] == p)
+            {
+                pids[k] = pids[--*running];
+                return account(status, rc);
+            }
+        }
+    }
+}
+
+/* The option value for argv[*i] for -P/-n (attached or the next
+ * word, advancing *i), or NULL if missing
+ */
+static const char *opt_value(char **argv, int *i)
+{
+    if (argv[*i][2])
+        return argv[*i] + 2;
+    if (argv[*i + 1])
+        return argv[++*i];
+    return NULL;
+}
+
+int xargs_supported(char **argv)
+{
+    if (!argv || !argv[0] || strcmp(argv[0], "xargs") != 0)
+        return 0;
+    /* anything beyond -P, -n and -0 is left to the real xargs */
+    for (int i = 1; argv[i] && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "--") == 0)
+            break;
+        if (strcmp(argv[i], "-0") == 0)
+            continue;
+        if ((argv[i][1] == 'P' || argv[i][1] == 'n') && opt_value(argv, &i))
+            continue;
+        return 0;
+    }
+    return 1;
+}
+
+int xargs_run(char **argv, pid_t (*spawn)(char **argv, const char *path))
+{
+    long procs = 1;
+    long max_items = 0;
+    int nul = 0;
+
+    int i = 1;
+    while (argv[i] && argv[i][0] == '-')
+    {
+        /* -P N / -n M, or attached: -PN / -nM */
+        char opt = argv[i][1];
+        const char *val = (opt == 'P' || opt == 'n') ? opt_value(argv, &i) : NULL;
+
+        char *end = NULL;
+        if (strcmp(argv[i], "-0") == 0)
+            nul = 1;
+        else if (opt == 'P' && val)
+        {
+            procs = strtol(val, &end, 10);
+            if (end == val || *end || procs < 0)
+                procs = -1;
+        }
+        else if (opt == 'n' && val)
+        {
+            max_items = strtol(val, &end, 10);
+            if (end == val || *end || max_items < 1)
+                procs = -1;
+        }
+        else if (strcmp(argv[i], "--") == 0)
+        {
+            i++;
+            break;
+        }
+        else
+            procs = -1;
+        if (procs < 0)
+        {
+            fprintf(stderr, "Usage: xargs [-P N] [-n M] [-0] [cmd [args...]]\n");
+            return 1;
+        }
+        i++;
+    }
+    if (procs == 0)
+        procs = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+
+    static char *echo_argv[] = {"echo", NULL};
+    char **cmd = argv[i] ? &argv[i] : echo_argv;
+    int ncmd = 0;
+    size_t fixed = sizeof(char *); /* argv's NULL */
+    for (; cmd[ncmd]; ncmd++)
+        fixed += strlen(cmd[ncmd]) + 1 + sizeof(char *);
+
+    /* one PATH lookup serves every batch */
+    char *path = which_in_path(cmd[0]);
+    if (!path && !filecmd_supported(cmd))
+    {
+        fprintf(stderr, "xargs: %s: command not found\n", cmd[0]);
+        return 127;
+    }
+
+    long argmax = sysconf(_SC_ARG_MAX);
+    if (argmax <= 0)
+        argmax = 128 * 1024;
+    long budget = argmax - (long)env_size() - (long)fixed - ARG_HEADROOM;
+    if (budget <= 0)
+    {
+        fprintf(stderr, "xargs: environment and command leave no room for arguments\n");
+        free(path);
+        return 1;
+    }
+
+    /* batches are our children: reap them here, not in the shell's handler */
+    signal(SIGCHLD, SIG_DFL);
+
+    reader_t r = {0};
+    r.nul = nul;
+    size_t bcap = (size_t)ncmd + 64;
+    char **bargv = malloc(bcap * sizeof(char *));
+    if (!bargv)
+    {
+        perror("xargs: malloc");
+        free(path);
+        return 1;
+    }
+    memcpy(bargv, cmd, ncmd * sizeof(char *));
+    pid_t *pids = NULL; /* batches still running */
+    int pcap = 0;
+
+    int rc = 0;
+    int running = 0;
+    int stop = 0;
+    char *item = next_item(&r);
+    while (item && !stop)
+    {
+        /* pack items until the next one would not fit */
+        int n = ncmd;
+        long used = 0;
+        while (item && (max_items == 0 || n - ncmd < max_items))
+        {
+            long cost = (long)(strlen(item) + 1 + sizeof(char *));
+            if (used + cost > budget)
+            {
+                if (n == ncmd)
+                {
+                    fprintf(stderr, "xargs: argument too long\n");
+                    free(item);
+                    item = NULL;
+                    if (rc < 1)
+                        rc = 1;
+                }
+                break;
+            }
+            if ((size_t)n + 2 > bcap)
+            {
+                bcap *= 2;
+                char **nb = realloc(bargv, bcap * sizeof(char *));
+                if (!nb)
+                {
+                    perror("xargs: realloc");
+                    _exit(1);
+                }
+                bargv = nb;
+            }
+            bargv[n++] = item;
+            used += cost;
+            item = next_item(&r);
+        }
+        if (n == ncmd)
+            break;
+        bargv[n] = NULL;
+
+        while (running >= procs && !stop)
+            stop = reap_batch(pids, &running, &rc);
+        if (!stop)
+        {
+            if (running == pcap)
+            {
+                pcap = pcap ? pcap * 2 : 16;
+                pid_t *np = realloc(pids, pcap * sizeof(pid_t));
+                if (!np)
+                {
+                    perror("xargs: realloc");
+                    _exit(1);
+                }
+                pids = np;
+            }
+            pid_t pid = spawn(bargv, path);
+            if (pid > 0)
+                pids[running++] = pid;
+            else if (rc < 126)
+                rc = 126;
+        }
+
+        for (int k = ncmd; k < n; k++)
+            free(bargv[k]);
+    }
+    free(item);
+    if (r.err && rc < 1)
+        rc = 1;
+
+    while (running > 0)
+        reap_batch(pids, &running, &rc);
+
+    free(pids);
+    free(bargv);
+    free(r.buf);
+    free(r.scratch);
+    free(path);
+    return rc;
+}
@@ -0,0 +1,43 @@
+#!/bin/bash
+# Feature checks: each case pipes a script into ./shell and compares what
+# it prints (prompts and "[bg] PID" lines removed) with the expected text.
+# The checks live in tests/features/, one file per feature, and share
+# check() and $tmp from here. Run through `make check`.
+
+cd "$(dirname "$0")/.." || exit 1
+OSH=./shell
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+unset OSH_HISTFILE
+
+pass=0
+fail=0
+
+run_osh() {
+    printf '%s\n' "$1" | "$OSH" 2>/dev/null | sed 's/osh> //g' | grep -v '^\[bg\] [0-9]*$'
+}
+
+# compare NAME EXPECTED GOT
+compare() {
+    local name=$1 expected=$2 got=$3
+    if [ "$got" == "$expected" ]; then
+        pass=$((pass + 1))
+    else
+        fail=$((fail + 1))
+        echo "FAIL: $name"
+        diff <(printf '%s\n' "$expected") <(printf '%s\n' "$got") | sed 's/^/    /'
+    fi
+}
+
+# check NAME INPUT EXPECTED [PATTERN]: PATTERN keeps only matching lines
+check() {
+    compare "$1" "$3" "$(run_osh "$2" | grep -e "${4:-}")"
+}
+
+for f in tests/features/*.sh; do
+    . "$f"
+done
+
+echo
+echo "$pass passed, $fail failed"
+[ "$fail" -eq 0 ]
@@ -0,0 +1,24 @@
+# tests/features/capture.sh: background output capture and jobs -o
+
+echo "=== Capture ==="
+check "background output is captured" \
+'capture on 64K
+echo captured &
+sleep 0.3
+jobs -o %1' \
+'captured'
+check "finished job's ring is freed once read" \
+'capture on 64K
+echo captured &
+sleep 0.3
+jobs -o %1
+jobs -o %1' \
+'captured
+No captured output for job %1'
+check "finished job's ring is freed once listed" \
+'capture on 64K
+echo captured &
+sleep 0.3
+jobs
+jobs -o %1' \
+'No captured output for job %1' '^No'
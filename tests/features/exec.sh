@@ -0,0 +1,25 @@
+# tests/features/exec.sh: running commands and counting exec failures
+
+echo "=== Exec failures ==="
+echo data > "$tmp/notexec"
+check "not found gives 127, not executable 126" \
+"nosuchcmd_osh_test
+echo \$?
+$tmp/notexec
+echo \$?" \
+'127
+126'
+check "exec failures are counted" \
+"nosuchcmd_osh_test
+$tmp
+$tmp/notexec
+stats" \
+'exec_failures    3' \
+'^exec_failures'
+check "background exec failures are counted" \
+"nosuchcmd_osh_test &
+sleep 0.2
+jobs
+stats" \
+'exec_failures    1' \
+'^exec_failures'
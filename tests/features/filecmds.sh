@@ -0,0 +1,41 @@
+# tests/features/filecmds.sh: builtin cat and cp
+
+echo "=== Builtin cat/cp ==="
+seq 100000 > "$tmp/f"
+mkdir -p "$tmp/dir"
+check "cat file to file runs inline" \
+"cat $tmp/f > $tmp/c1
+stats" \
+'forks            0' \
+'^forks'
+check "cat copies" \
+"cmp $tmp/f $tmp/c1 && echo same" \
+'same'
+check "cp file, and into a directory, runs inline" \
+"cp $tmp/f $tmp/c2
+cp $tmp/f $tmp/c1 $tmp/dir
+stats" \
+'forks            0' \
+'^forks'
+check "cp copies" \
+"cmp $tmp/f $tmp/c2 && cmp $tmp/f $tmp/dir/f && cmp $tmp/f $tmp/dir/c1 && echo same" \
+'same'
+check "cat to a terminal or pipe forks" \
+"cat $tmp/f
+stats" \
+'forks            1' \
+'^forks'
+check "cat file into a pipe (sendfile)" \
+"cat $tmp/f | wc -l" \
+'100000'
+check "cat from a pipe (splice)" \
+"seq 100000 | cat > $tmp/c3
+cmp $tmp/f $tmp/c3 && echo same" \
+'same'
+check "cat -, stdin and several files" \
+"echo mid | cat $tmp/f - $tmp/f | wc -l" \
+'200001'
+check "cat missing file" \
+"cat $tmp/nope > $tmp/c4
+echo \$?" \
+'1'
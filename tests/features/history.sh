@@ -0,0 +1,24 @@
+# tests/features/history.sh: persistent history and its search index
+
+echo "=== History ==="
+printf 'echo one\necho two\necho three\n' | OSH_HISTFILE="$tmp/hist" "$OSH" > /dev/null 2>&1
+OSH_HISTFILE="$tmp/hist" check "history search" \
+'history -g tw
+history -g "echo t"
+!echo' \
+'    2  echo two
+    4  history -g tw
+    2  echo two
+    3  echo three
+    5  history -g "echo t"
+echo three
+three'
+# no room for the .idx/.gram/.post suffixes: history is off, nothing created
+mkdir "$tmp/longhist"
+long=$(printf './%.0s' $(seq 2045))h
+got=$(cd "$tmp/longhist" && echo 'echo hi' | OSH_HISTFILE="$long" "$OLDPWD/$OSH" 2>&1 | sed 's/osh> //g')
+compare "history path too long" \
+'osh: history: path too long
+hi
+files: 0' "$got
+files: $(ls -A "$tmp/longhist" | wc -l)"
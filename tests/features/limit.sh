@@ -0,0 +1,19 @@
+# tests/features/limit.sh: the limit prefix
+
+echo "=== Resource limits ==="
+check "oversized --mem" \
+'limit --mem 99999999999T true
+echo $?' \
+'2'
+check "--nofile takes a count" \
+"limit --nofile 64 sh -c 'ulimit -n'
+limit --nofile 1K true
+echo \$?" \
+'64
+2'
+check "--mem sets the address space limit" \
+"limit --mem 512M sh -c 'ulimit -v'" \
+'524288'
+check "--nice lowers priority" \
+"limit --nice 5 sh -c 'cut -d\" \" -f19 /proc/\$\$/stat'" \
+'5'
@@ -0,0 +1,31 @@
+# tests/features/lists.sh: ; & && || command lists and $?
+
+echo "=== Command lists and \$? ==="
+check "and/or" \
+'false && echo no
+echo $?
+false || echo yes
+true; false; echo $?' \
+'1
+yes
+1'
+check "parse error stops &&" \
+'echo > && echo SHOULD_NOT_RUN
+echo $?' \
+'2'
+check "syntax error sets 2" \
+'true
+&& echo x
+echo $?' \
+'2'
+check "sequence and short-circuit" \
+'echo a; echo b && false || echo c; echo $?' \
+'a
+b
+c
+0'
+check "background entry does not block the list" \
+'sleep 1 & echo next
+echo $?' \
+'next
+0'
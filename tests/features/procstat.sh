@@ -0,0 +1,16 @@
+# tests/features/procstat.sh: per-stage rates from jobs -v
+
+echo "=== jobs -v ==="
+# job line, header, then one row per stage: index, command, read and write rates
+compare "jobs -v lists every stage" \
+'[1] Running (sh -c "head -c 20000000 /dev/zero; sleep 1" | wc -c)
+stage pid command S read write cpu blocked
+0 sh rate rate
+1 wc rate rate' \
+"$(run_osh 'sh -c "head -c 20000000 /dev/zero; sleep 1" | wc -c &
+sleep 0.3
+jobs -v' | awk '
+    NF == 0 || /^[0-9]+$/ { next }
+    NR == 1 { $2 = ""; gsub(/ +/, " "); print; next }
+    $1 == "stage" { $1 = $1; print; next }
+    { print $1, $3, ($5 ~ /\/s$/ ? "rate" : $5), ($6 ~ /\/s$/ ? "rate" : $6) }')"
@@ -0,0 +1,22 @@
+# tests/features/procsub.sh: <(...) and >(...) process substitution
+echo "=== Process substitution ==="
+check "input substitutions" \
+'diff <(echo a) <(echo a) && echo same
+wc -l < <(seq 5)' \
+'same
+5'
+check "output substitution" \
+"seq 3 > >(cat > $tmp/procsub)
+sleep 0.3
+cat $tmp/procsub" \
+'1
+2
+3'
+check "more than 16 input substitutions" \
+"cat$(for i in $(seq 18); do printf ' <(echo %d)' "$i"; done) | wc -l" \
+'18'
+check "every output substitution sees EOF" \
+"seq 4 | tee$(for i in $(seq 18); do printf ' >(wc -l > %s/ps%d)' "$tmp" "$i"; done) > /dev/null
+sleep 0.5
+cat$(for i in $(seq 18); do printf ' %s/ps%d' "$tmp" "$i"; done) | sort | uniq -c | awk '{print \$1, \$2}'" \
+'18 4'
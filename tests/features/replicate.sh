@@ -0,0 +1,32 @@
+# tests/features/replicate.sh: |[N] data-parallel stages
+
+echo "=== Ordered replication ==="
+seq 200000 > "$tmp/seq"
+grep 7 "$tmp/seq" > "$tmp/seq7"
+check "ordered cat keeps order" \
+"seq 200000 |[4,ordered] cat > $tmp/o1
+cmp $tmp/o1 $tmp/seq && echo same" \
+'same'
+check "ordered filter keeps order" \
+"seq 200000 |[4,ordered] grep 7 > $tmp/o2
+cmp $tmp/o2 $tmp/seq7 && echo same" \
+'same'
+check "unordered keeps every record" \
+"seq 200000 |[4] grep 7 | sort -n > $tmp/o3
+cmp $tmp/o3 $tmp/seq7 && echo same" \
+'same'
+check "no procsub on replicated stage" \
+"echo 1 |[2] cat > >(cat)
+echo \$?" \
+'2'
+check "ordered with a small chunk keeps order" \
+"seq 200000 |[3,ordered,chunk=4K] grep 7 > $tmp/o4
+cmp $tmp/o4 $tmp/seq7 && echo same" \
+'same'
+check "ordered splits a short file across workers" \
+"true |[4,ordered] wc -l < $tmp/seq | awk '{ n++; s += \$1 } END { print n, s }'" \
+'4 200000'
+check "bad chunk size" \
+"echo 1 |[2,chunk=10] cat
+echo \$?" \
+'2'
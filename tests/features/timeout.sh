@@ -0,0 +1,30 @@
+# tests/features/timeout.sh: the timeout prefix
+
+echo "=== Timeouts ==="
+check "expiry gives 124" \
+'timeout 0.2 sleep 5
+echo $?' \
+'124'
+check "SIGKILL escalation gives 137" \
+"timeout -k 0.2 0.2 sh -c 'trap \"\" TERM; sleep 5'
+echo \$?" \
+'137'
+check "timeout 0 is no limit" \
+"timeout 0 sh -c 'sleep 0.1; exit 3'
+echo \$?" \
+'3'
+check "non-finite or huge durations are rejected" \
+'timeout inf true
+echo $?
+timeout 1e300 true
+echo $?
+timeout -k nan 1 true
+echo $?' \
+'2
+2
+2'
+compare "timed background job shows as timed out" \
+'Timed out' \
+"$(run_osh 'timeout 0.2 sleep 5 &
+sleep 0.5
+jobs' | grep -o 'Timed out')"
@@ -0,0 +1,37 @@
+# tests/features/xargs.sh: builtin xargs batching, quoting and exit codes
+
+echo "=== xargs ==="
+check "batches of -n" \
+'seq 10 | xargs -n 3 echo' \
+'1 2 3
+4 5 6
+7 8 9
+10'
+check "parallel batches keep every item" \
+'seq 10000 | xargs -n 7 -P 3 echo | wc -w' \
+'10000'
+check "quoting" \
+"echo '\"a b\" c d\\ e' | xargs -n1 echo" \
+'a b
+c
+d e'
+check "-0" \
+"printf 'a b\\0c\\0' | xargs -0 -n1 echo" \
+'a b
+c'
+check "other options use the system xargs" \
+"printf 'x\\ny\\n' | xargs -I{} echo item {}" \
+'item x
+item y'
+check "failed batch gives 123" \
+'seq 3 | xargs false
+echo $?' \
+'123'
+check "waits for every batch, not procsub helpers" \
+"xargs -P 2 -n 1 sh -c 'sleep 0.3; echo got' < <(seq 4)
+echo after" \
+'got
+got
+got
+got
+after'